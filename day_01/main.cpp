@@ -1,91 +1,251 @@
+#include <array>
+#include <cstdint>
 #include <fstream>
-#include <map>
-#include <ranges>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <iostream>
+#include "../utils.hpp"
 
 
-const std::map<std::string, std::string> number_converter = {
-    {"one", "1"},
-    {"two", "2"},
-    {"three", "3"},
-    {"four", "4"},
-    {"five", "5"},
-    {"six", "6"},
-    {"seven", "7"},
-    {"eight", "8"},
-    {"nine", "9"},
+constexpr std::array<std::string_view, 9> spelled_digits = {
+    "one", "two", "three", "four", "five", "six", "seven", "eight", "nine",
 };
 
 
-char get_first_digit(const std::ranges::view auto& line)
+/*
+ * Aho-Corasick automaton over "one".."nine" and '1'..'9', flattened into a full
+ * transition table so that matching costs one lookup per character. The
+ * reversed variant matches the reversed patterns and is fed the line from the
+ * end. No pattern contains another one, so the first match reached while
+ * scanning is also the one that starts first (or ends last when reversed).
+ */
+struct DigitAutomaton
 {
-    auto digit = std::ranges::find_if(line, [](char c) { return std::isdigit(c); });
-    if (digit != line.end()) {
-        return *digit;
-    }
-    throw std::runtime_error("No digit found");
-}
+    static constexpr size_t MAX_STATES = 64;
 
-int get_number_part2(const std::string& line)
-{
-    // we only need to convert once from the beginning and once from the end
-    std::string full_digit = "";
-    std::pair<size_t, std::string> first_num_pos = {std::string::npos, ""};
-    for (const auto& [word, digit] : number_converter)
+    std::array<std::array<uint8_t, 256>, MAX_STATES> next {};
+    std::array<uint8_t, MAX_STATES> digit {};
+
+    constexpr explicit DigitAutomaton(bool reversed)
     {
-        auto pos = std::min(line.find(word), line.find(digit));
-        if (pos != std::string::npos && pos < first_num_pos.first)
+        size_t nStates = 1;
+        auto insert = [&](std::string_view pattern, uint8_t value)
+        {
+            size_t state = 0;
+            for (size_t i = 0; i < pattern.size(); ++i)
+            {
+                const auto c = static_cast<unsigned char>(
+                    reversed ? pattern[pattern.size() - 1 - i] : pattern[i]);
+                if (next[state][c] == 0)
+                {
+                    next[state][c] = static_cast<uint8_t>(nStates++);
+                }
+                state = next[state][c];
+            }
+            digit[state] = value;
+        };
+        for (uint8_t value = 1; value <= 9; ++value)
+        {
+            insert(spelled_digits[value - 1], value);
+            const char numeral[] = {static_cast<char>('0' + value)};
+            insert({numeral, 1}, value);
+        }
+
+        // Breadth first over the trie, turning missing edges into failure jumps
+        std::array<uint8_t, MAX_STATES> fail {};
+        std::array<uint8_t, MAX_STATES> queue {};
+        size_t head = 0;
+        size_t tail = 0;
+        for (auto& child : next[0])
+        {
+            if (child != 0)
+            {
+                queue[tail++] = child;
+            }
+        }
+        while (head < tail)
         {
-            first_num_pos = {pos, digit};
+            const uint8_t state = queue[head++];
+            if (digit[state] == 0)
+            {
+                digit[state] = digit[fail[state]];
+            }
+            for (size_t c = 0; c < 256; ++c)
+            {
+                const uint8_t fallback = next[fail[state]][c];
+                if (next[state][c] == 0)
+                {
+                    next[state][c] = fallback;
+                }
+                else
+                {
+                    fail[next[state][c]] = fallback;
+                    queue[tail++] = next[state][c];
+                }
+            }
         }
     }
-    if (first_num_pos.first != std::string::npos)
+
+    template<typename It>
+    int firstMatch(It begin, It end) const
     {
-        full_digit += first_num_pos.second;
+        uint8_t state = 0;
+        for (; begin != end; ++begin)
+        {
+            state = next[state][static_cast<unsigned char>(*begin)];
+            if (digit[state] != 0)
+            {
+                return digit[state];
+            }
+        }
+        return 0;
     }
-    // now invert the string and do the same again
-    std::pair<size_t, std::string> last_num_pos = {std::string::npos, ""};
-    auto reversed_line = line;
-    std::reverse(reversed_line.begin(), reversed_line.end());
-    for (const auto& [word, digit] : number_converter)
+};
+
+constexpr DigitAutomaton forward_automaton {false};
+constexpr DigitAutomaton backward_automaton {true};
+
+
+/*
+ * Part 1 over the whole buffer at once. Each block gives a digit mask and a
+ * newline mask; the first digit of a line is found with tzcnt and the last one
+ * with lzcnt on the digits that fall before the next newline.
+ */
+uint64 sum_first_last_digits(std::string_view buffer)
+{
+    uint64 total = 0;
+    int first = -1;
+    int last = 0;
+    for (size_t offset = 0; offset < buffer.size(); offset += SIMD_BLOCK)
     {
-        auto reversed_word = word;
-        std::reverse(reversed_word.begin(), reversed_word.end());
-        auto pos = std::min(reversed_line.find(reversed_word), reversed_line.find(digit));
-        if (pos != std::string::npos && pos < last_num_pos.first)
+        const char* block = buffer.data() + offset;
+        const size_t size = std::min(SIMD_BLOCK, buffer.size() - offset);
+        uint32 digits = digitMask(block, size);
+        uint32 newlines = eqMask(block, '\n', size);
+        while (true)
         {
-            last_num_pos = {pos, digit};
+            const size_t lineEnd = newlines != 0 ? std::countr_zero(newlines) : size;
+            const uint32 inLine = digits & blockBits(lineEnd);
+            if (inLine != 0)
+            {
+                if (first < 0)
+                {
+                    first = block[std::countr_zero(inLine)] - '0';
+                }
+                last = block[31 - std::countl_zero(inLine)] - '0';
+            }
+            if (newlines == 0)
+            {
+                break;
+            }
+            if (first >= 0)
+            {
+                total += 10 * first + last;
+                first = -1;
+            }
+            digits &= ~blockBits(lineEnd + 1);
+            newlines &= newlines - 1;
         }
     }
-    if (last_num_pos.first != std::string::npos)
+    if (first >= 0)
     {
-        full_digit += last_num_pos.second;
+        total += 10 * first + last;
     }
+    return total;
+}
 
-    if (full_digit.empty())
+// 0 when the line has no digit, spelled or not
+int get_number_part2(std::string_view line)
+{
+    // we only need to match once from the beginning and once from the end
+    const int first = forward_automaton.firstMatch(line.begin(), line.end());
+    const int last = backward_automaton.firstMatch(line.rbegin(), line.rend());
+    if (first == 0)
     {
-        std::cout << "No digits found in line: " << line << std::endl;
         return 0;
     }
-    return std::stoi(full_digit);
+    return 10 * first + last;
 }
 
-int main() {
-    std::ifstream file("input.txt");
+/*
+ * Everything a worker produces for its chunk. Lines are only printed by main
+ * once the workers have joined, so output from different chunks never
+ * interleaves.
+ */
+struct ChunkResult
+{
+    uint64 part1 {0};
+    uint64 part2 {0};
+    std::vector<std::array<int, 2>> lineValues {};
+    std::vector<std::string_view> linesWithoutDigits {};
+};
+
+ChunkResult solve_chunk(std::string_view chunk, bool audit)
+{
+    ChunkResult result;
+    if (!audit)
+    {
+        result.part1 = sum_first_last_digits(chunk);
+        for (const auto line : lines(chunk))
+        {
+            const int value2 = get_number_part2(line);
+            if (value2 == 0)
+            {
+                result.linesWithoutDigits.push_back(line);
+            }
+            result.part2 += value2;
+        }
+        return result;
+    }
+    for (const auto line : lines(chunk))
+    {
+        const int value1 = static_cast<int>(sum_first_last_digits(line));
+        const int value2 = get_number_part2(line);
+        if (value2 == 0)
+        {
+            result.linesWithoutDigits.push_back(line);
+        }
+        result.part1 += value1;
+        result.part2 += value2;
+        result.lineValues.push_back({value1, value2});
+    }
+    return result;
+}
+
+/*
+ * Usage: main [--audit]
+ * The input is split on line boundaries into one chunk per hardware thread.
+ * With --audit the value of every line is printed for both parts before the
+ * totals.
+ */
+int main(int argc, char* argv[]) {
+    const bool audit = argc > 1 && std::string_view(argv[1]) == "--audit";
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
-    int part1 = 0;
-    int part2 = 0;
-    for (const auto& line : std::ranges::istream_view<std::string>(file)) {
-        auto line_view = std::views::all(line);
-        char first_digit = get_first_digit(line_view);
-        char last_digit = get_first_digit(line_view | std::views::reverse);
-        part1 += std::stoi(std::string({first_digit, last_digit}));
-        part2 += get_number_part2(line);
+    const auto chunks = splitOnLines(file.view(), defaultThreadCount());
+    std::vector<ChunkResult> results(chunks.size());
+    parallel_for(chunks.size(),
+                 [&](size_t i) { results[i] = solve_chunk(chunks[i], audit); });
+
+    uint64 part1 = 0;
+    uint64 part2 = 0;
+    size_t lineNumber = 0;
+    for (const auto& result : results) {
+        part1 += result.part1;
+        part2 += result.part2;
+        for (const auto& [value1, value2] : result.lineValues) {
+            std::cout << "Line " << ++lineNumber << ": " << value1 << ' ' << value2 << '\n';
+        }
+    }
+    for (const auto& result : results) {
+        for (const auto line : result.linesWithoutDigits) {
+            std::cout << "No digits found in line: " << line << '\n';
+        }
     }
     std::cout << "Part 1: " << part1 << '\n';
     std::cout << "Part 2: " << part2 << '\n';
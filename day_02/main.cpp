@@ -1,107 +1,292 @@
-#include <fstream>
-#include <string>
-#include <vector>
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <string_view>
 #include <iostream>
-#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
 #include "../utils.hpp"
 
 
-class Turn {
+/*
+ * Parses a game line in a single pass. Reveals are not stored, only the
+ * running maximum of each colour, which is all both parts need. Colours are
+ * told apart by their first letter. Problems are reported on stderr and leave
+ * the game not well formed.
+ */
+class Game {
 public:
-    int red {0};
-    int green {0};
-    int blue {0};
-
-    Turn(const std::string& turnStr) {
-        auto colorsSpl = split(turnStr, ", ");
-        for (const auto& colorStr : colorsSpl) {
-            setColor(colorStr);
+    static constexpr int RED_LIMIT = 12;
+    static constexpr int GREEN_LIMIT = 13;
+    static constexpr int BLUE_LIMIT = 14;
+
+    Game(std::string_view line)
+    {
+        const char* it = line.data();
+        const char* const last = line.data() + line.size();
+        const auto [idEnd, idError] = std::from_chars(skipTo(it, last), last, id);
+        if (idError != std::errc {}) {
+            std::cerr << "Invalid game id: " << line << '\n';
+            wellFormed = false;
+            return;
+        }
+        it = idEnd;
+        while ((it = skipTo(it, last)) != last) {
+            int count = 0;
+            const auto [countEnd, countError] = std::from_chars(it, last, count);
+            it = countEnd + 1;
+            if (countError != std::errc {} || it >= last) {
+                std::cerr << "Invalid game: " << line << '\n';
+                wellFormed = false;
+                break;
+            }
+            switch (*it) {
+                case 'r':
+                    maxBalls[0] = std::max(maxBalls[0], count);
+                    break;
+                case 'g':
+                    maxBalls[1] = std::max(maxBalls[1], count);
+                    break;
+                case 'b':
+                    maxBalls[2] = std::max(maxBalls[2], count);
+                    break;
+                default:
+                    std::cerr << "Invalid color name at: " << std::string_view(it, last) << '\n';
+                    wellFormed = false;
+            }
         }
     }
 
-    void setColor(const std::string& colorStr) {
-        auto colorSpl = split(colorStr, " ");
-        int colorNum = std::stoi(colorSpl[0]);
-        std::string colorName = strip(colorSpl[1]);
-        if (colorName == "red") {
-            red = colorNum;
-        } else if (colorName == "green") {
-            green = colorNum;
-        } else if (colorName == "blue") {
-            blue = colorNum;
-        } else {
-            std::cerr << "Invalid color name: " << colorName << '\n';
-        }
+    bool isValid() const {
+        return maxBalls[0] <= RED_LIMIT && maxBalls[1] <= GREEN_LIMIT && maxBalls[2] <= BLUE_LIMIT;
+    }
+
+    bool isWellFormed() const {
+        return wellFormed;
+    }
+
+    uint64 getId() const {
+        return id;
     }
 
+    std::array<int, 3> getMinBallNumbers() const {
+        return maxBalls;
+    }
+
+private:
+    std::array<int, 3> maxBalls {0, 0, 0};
+    uint64 id {0};
+    bool wellFormed {true};
+
+    static const char* skipTo(const char* it, const char* last) {
+        while (it != last && !std::isdigit(*it)) {
+            ++it;
+        }
+        return it;
+    }
 };
 
 
-class Game {
+
+/*
+ * Offline 2D Fenwick tree over (green, blue) positions known up front. Row
+ * node i only keeps the sorted columns of the points whose update path passes
+ * through it, each with a 1D Fenwick tree over them, so memory grows with
+ * points × log(rows) rather than rows × columns.
+ */
+class Fenwick2D {
 public:
-    static constexpr int RED_LIMIT = 12;
-    static constexpr int GREEN_LIMIT = 13;
-    static constexpr int BLUE_LIMIT = 14;
+    using Point = std::pair<size_t, size_t>;
 
-    Game(const std::string& line)
-    {
-        auto lineSpl = split(line, ": ");
-        id = std::stoi(split(lineSpl[0], " ")[1]);
-        auto turnsStrings = split(lineSpl[1], "; ");
-        for (const auto& turnStr : turnsStrings) {
-            turns.emplace_back(turnStr);
+    // Points are the 1-based (row, col) positions that add may be called with
+    Fenwick2D(size_t nRows, const std::vector<Point>& points) : cols(nRows), sums(nRows) {
+        for (const auto& [row, col] : points) {
+            for (size_t i = row; i <= nRows; i += i & -i) {
+                cols[i - 1].push_back(col);
+            }
+        }
+        for (size_t i = 0; i < nRows; ++i) {
+            std::ranges::sort(cols[i]);
+            cols[i].erase(std::ranges::unique(cols[i]).begin(), cols[i].end());
+            sums[i].assign(cols[i].size(), 0);
         }
     }
 
-    bool isValid() const {
-        return std::ranges::all_of(turns, [](const auto& turn) {
-            return turn.red <= RED_LIMIT && turn.green <= GREEN_LIMIT && turn.blue <= BLUE_LIMIT;
-        });
+    // Adds value at the 1-based position (row, col), which must be one of the points
+    void add(size_t row, size_t col, uint64 value) {
+        for (size_t i = row; i <= cols.size(); i += i & -i) {
+            const auto& nodeCols = cols[i - 1];
+            assert(std::ranges::binary_search(nodeCols, col));
+            const size_t first = std::ranges::lower_bound(nodeCols, col) - nodeCols.begin() + 1;
+            for (size_t j = first; j <= nodeCols.size(); j += j & -j) {
+                sums[i - 1][j - 1] += value;
+            }
+        }
     }
 
-    int getId() const {
-        return id;
+    // Sum of every position with row' <= row and col' <= col
+    uint64 prefixSum(size_t row, size_t col) const {
+        uint64 result = 0;
+        for (size_t i = row; i > 0; i -= i & -i) {
+            const auto& nodeCols = cols[i - 1];
+            for (size_t j = std::ranges::upper_bound(nodeCols, col) - nodeCols.begin(); j > 0; j -= j & -j) {
+                result += sums[i - 1][j - 1];
+            }
+        }
+        return result;
     }
 
-    std::array<int, 3> getMinBallNumbers() const {
-        std::array<int, 3> result {0, 0, 0};
-        for (const auto& turn : turns) {
-            result[0] = std::max(result[0], turn.red);
-            result[1] = std::max(result[1], turn.green);
-            result[2] = std::max(result[2], turn.blue);
+private:
+    std::vector<std::vector<size_t>> cols;
+    std::vector<std::vector<uint64>> sums;
+};
+
+
+/*
+ * Compact table with the maximum of each colour per game. Answers batches of
+ * "sum of the ids of the games possible with these limits" queries offline:
+ * games and queries are swept by red, and each query reads a 2D prefix sum
+ * over (green, blue) of the games inserted so far.
+ */
+class GameTable {
+public:
+    using Limits = std::array<int, 3>;
+
+    void add(const Game& game) {
+        maxBalls.push_back(game.getMinBallNumbers());
+        ids.push_back(game.getId());
+    }
+
+    std::vector<uint64> sumValidIds(const std::vector<Limits>& queries) const {
+        std::vector<int> greens = sortedUnique(1);
+        std::vector<int> blues = sortedUnique(2);
+        auto position = [](const std::vector<int>& values, int limit) {
+            return static_cast<size_t>(std::ranges::upper_bound(values, limit) - values.begin());
+        };
+
+        std::vector<size_t> gameOrder(ids.size());
+        std::iota(gameOrder.begin(), gameOrder.end(), 0);
+        std::ranges::sort(gameOrder, {}, [this](size_t i) { return maxBalls[i][0]; });
+        std::vector<size_t> queryOrder(queries.size());
+        std::iota(queryOrder.begin(), queryOrder.end(), 0);
+        std::ranges::sort(queryOrder, {}, [&queries](size_t i) { return queries[i][0]; });
+
+        std::vector<Fenwick2D::Point> points;
+        points.reserve(maxBalls.size());
+        for (const auto& balls : maxBalls) {
+            points.emplace_back(position(greens, balls[1]), position(blues, balls[2]));
+        }
+        Fenwick2D tree(greens.size(), points);
+        std::vector<uint64> result(queries.size(), 0);
+        auto nextGame = gameOrder.begin();
+        for (const size_t q : queryOrder) {
+            const auto& [red, green, blue] = queries[q];
+            for (; nextGame != gameOrder.end() && maxBalls[*nextGame][0] <= red; ++nextGame) {
+                const auto& balls = maxBalls[*nextGame];
+                tree.add(position(greens, balls[1]), position(blues, balls[2]), ids[*nextGame]);
+            }
+            result[q] = tree.prefixSum(position(greens, green), position(blues, blue));
         }
         return result;
     }
 
 private:
-    std::vector<Turn> turns;
-    int id;
+    std::vector<Limits> maxBalls;
+    std::vector<uint64> ids;
+
+    std::vector<int> sortedUnique(size_t color) const {
+        std::vector<int> values;
+        values.reserve(maxBalls.size());
+        for (const auto& balls : maxBalls) {
+            values.push_back(balls[color]);
+        }
+        std::ranges::sort(values);
+        values.erase(std::ranges::unique(values).begin(), values.end());
+        return values;
+    }
 };
 
 
+/*
+ * Usage: main [--queries FILE]
+ * With --queries, every line of FILE holds a "red green blue" limit and the
+ * sum of the ids of the games possible under it is printed, one per line.
+ */
+int answerQueries(const std::string& queriesPath) {
+    const MappedFile gamesFile("input.txt");
+    if (!gamesFile) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
+    GameTable table;
+    for (const auto line : lines(gamesFile.view())) {
+        const Game game(line);
+        if (!game.isWellFormed()) {
+            return 1;
+        }
+        table.add(game);
+    }
+
+    const MappedFile queriesFile(queriesPath);
+    if (!queriesFile) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
+    std::vector<GameTable::Limits> queries;
+    for (const auto line : lines(queriesFile.view())) {
+        GameTable::Limits limits {0, 0, 0};
+        size_t color = 0;
+        for (const int value : numbers<int>(line)) {
+            if (color < limits.size()) {
+                limits[color++] = value;
+            }
+        }
+        if (color != limits.size()) {
+            std::cerr << "Invalid query: " << line << '\n';
+            return 1;
+        }
+        queries.push_back(limits);
+    }
+
+    for (const uint64 sum : table.sumValidIds(queries)) {
+        std::cout << sum << '\n';
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string_view(argv[1]) == "--queries") {
+        return answerQueries(argv[2]);
+    }
 
-int main() {
-    std::ifstream file("input.txt");
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
-    std::string line;
-    int resultPart1 = 0;
-    int resultPart2 = 0;
-    while (std::getline(file, line)) {
-        Game game(line);
+    // Malformed games are left out of both parts and fail the run
+    int exitCode = 0;
+    uint64 resultPart1 = 0;
+    uint64 resultPart2 = 0;
+    for (const auto line : lines(file.view())) {
+        const Game game(line);
+        if (!game.isWellFormed()) {
+            exitCode = 1;
+            continue;
+        }
         if (game.isValid()) {
             resultPart1 += game.getId();
         }
         auto minBallNumbers = game.getMinBallNumbers();
-        resultPart2 += minBallNumbers[0] * minBallNumbers[1] * minBallNumbers[2];
+        resultPart2 += static_cast<uint64>(minBallNumbers[0]) * minBallNumbers[1] * minBallNumbers[2];
     }
 
     std::cout << "Part 1: " << resultPart1 << '\n';
     std::cout << "Part 2: " << resultPart2 << '\n';
 
-    return 0;
+    return exitCode;
 }
@@ -1,238 +1,468 @@
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <fstream>
-#include <ranges>
+#include <numeric>
+#include <optional>
 #include <string>
-#include <variant>
+#include <string_view>
 #include <vector>
 #include <iostream>
+#include "../utils.hpp"
 
 
-struct Empty {};
-
-struct Number
+struct NumberSpan
 {
-    int value;
-    bool isValid;
+    uint32 row;
+    uint32 colBegin;
+    uint32 colEnd;
+    int64 value;
 };
 
+/*
+ * The schematic is kept as the raw bytes of the input plus a table with the
+ * span of every number. Symbol adjacency is answered with a bit grid of the
+ * symbol positions dilated by one cell in every direction.
+ */
 class Array {
 public:
-    using Element = std::variant<Empty, Number, char>;
     Array() = default;
 
-    void addRow(const std::string& line) {
-        std::vector<Element> row;
-        for (const auto& c : line) {
-            if (c == '.')
-            {
-                row.push_back(Empty{});
-            }
-            else if (isdigit(c))
-            {
-                row.push_back(Number{std::stoi(std::string{c}), false});
-            }
-            else
-            {
-                row.push_back(c);
-            }
+    void addRow(std::string_view line) {
+        if (nRows == 0)
+        {
+            nCols = line.size();
         }
-        data.push_back(row);
+        grid.append(line);
+        ++nRows;
+        indexed = false;
     }
 
-    const std::vector<std::vector<Element>>& getData() const {
-        return data;
+    const std::string& getData() const {
+        return grid;
     }
 
     auto numRows() const {
-        return data.size();
+        return nRows;
     }
 
     auto numCols() const {
-        return data[0].size();
+        return nCols;
+    }
+
+    char at(size_t r, size_t c) const {
+        return grid[r * nCols + c];
     }
 
-    void fillFullNums()
+    /*
+     * The rows are split into one band per thread. Numbers never cross rows,
+     * so each band indexes and sums its own rows and only reads one row of
+     * halo above and below it for the symbol dilation and the gears, which
+     * gives the same result as the serial pass.
+     */
+    void buildIndex(size_t nThreads = 1)
     {
-        const auto& nRows = numRows();
-        const auto& nCols = numCols();
-        std::vector<int> fullNumsIdsRow {};
-        fullNums.clear();
-        fullNumIds.clear();
-        int currentNumberId = 0;
-        for (auto i = 0; i < nRows; ++i)
+        wordsPerRow = (nCols + 63) / 64;
+        const size_t nBands = bandCount(nThreads);
+        std::vector<uint64> symbols(nRows * wordsPerRow, 0);
+        std::vector<std::vector<NumberSpan>> bandSpans(nBands);
+        std::vector<size_t> spansPerRow(nRows, 0);
+        parallel_for(nBands, [&](size_t band) {
+            const auto [first, last] = bandRows(band, nBands);
+            for (size_t r = first; r < last; ++r)
+            {
+                const size_t before = bandSpans[band].size();
+                indexRow(r, symbols.data() + r * wordsPerRow, bandSpans[band]);
+                spansPerRow[r] = bandSpans[band].size() - before;
+            }
+        }, nThreads);
+
+        spans.clear();
+        for (const auto& band : bandSpans)
         {
-            const auto& row = data[i];
-            fullNumsIdsRow.clear();
-            int currentNumber = 0;
-            for (auto j = 0; j < nCols; ++j)
+            spans.insert(spans.end(), band.begin(), band.end());
+        }
+        rowSpans.assign(1, 0);
+        for (const size_t count : spansPerRow)
+        {
+            rowSpans.push_back(rowSpans.back() + count);
+        }
+        nearSymbol = dilate(symbols, nThreads);
+        indexed = true;
+    }
+
+    int64 sumValidNumbers(size_t nThreads = 1)
+    {
+        if (!indexed)
+        {
+            buildIndex(nThreads);
+        }
+        const size_t nBands = bandCount(nThreads);
+        std::vector<int64> bandResults(nBands, 0);
+        parallel_for(nBands, [&](size_t band) {
+            const auto [first, last] = bandRows(band, nBands);
+            for (size_t i = rowSpans[first]; i < rowSpans[last]; ++i)
             {
-                const auto& element = row[j];
-                if (std::holds_alternative<Number>(element))
+                if (isNearSymbol(spans[i]))
                 {
-                    const auto& number = std::get<Number>(element);
-                    currentNumber = currentNumber * 10 + number.value;
-                    fullNumsIdsRow.push_back(currentNumberId);
+                    bandResults[band] += spans[i].value;
                 }
-                else
-                {
-                    if (currentNumber != 0)
-                    {
-                        fullNums.push_back(currentNumber);
-                        ++currentNumberId;
-                        currentNumber = 0;
-                    }
-                    fullNumsIdsRow.push_back(-1);
-                }
-            }
-            if (currentNumber != 0)
-            {
-                fullNums.push_back(currentNumber);
-                ++currentNumberId;
             }
-            fullNumIds.push_back(fullNumsIdsRow);
-        }
+        }, nThreads);
+        return std::accumulate(bandResults.begin(), bandResults.end(), int64 {0});
     }
 
-    int sumValidNumbers()
+    int64 sumConnectedToGears(size_t nThreads = 1)
     {
-        if (fullNums.empty())
+        if (!indexed)
         {
-            fillFullNums();
+            buildIndex(nThreads);
         }
-        const auto& nRows = numRows();
-        const auto& nCols = numCols();
-        int result = 0;
-        int lastAddedId = -1;
-        for (auto i = 0; i < nRows; ++i)
+        const size_t nBands = bandCount(nThreads);
+        std::vector<std::optional<int64>> bandResults(nBands);
+        parallel_for(nBands, [&](size_t band) {
+            const auto [first, last] = bandRows(band, nBands);
+            bandResults[band] = sumGearsInRows(first, last);
+        }, nThreads);
+        int64 result = 0;
+        for (const auto& bandResult : bandResults)
         {
-            const auto& row = data[i];
-            for (auto j = 0; j < nCols; ++j)
+            if (!bandResult)
             {
-                const auto& element = row[j];
-                if (std::holds_alternative<Number>(element))
-                {
-                    const auto& numId = fullNumIds[i][j];
-                    if (lastAddedId != numId && isValidPosition(i, j, nRows, nCols))
-                    {
-                        result += fullNums[numId];
-                        lastAddedId = numId;
-                    }
-                }
+                std::cout << "Error: more than 2 connected numbers" << std::endl;
+                return -1;
             }
+            result += *bandResult;
         }
         return result;
     }
 
-    int sumConnectedToGears()
+    std::vector<int64> getConnectedNums(size_t r, size_t c) const
     {
-        if (fullNums.empty())
+        std::vector<int64> result;
+        for (size_t row = r == 0 ? 0 : r - 1; row <= std::min(r + 1, nRows - 1); ++row)
         {
-            fillFullNums();
+            // Spans of a row are sorted by column, start at the first one ending after c - 1
+            const auto first = spans.begin() + rowSpans[row];
+            const auto last = spans.begin() + rowSpans[row + 1];
+            auto it = std::partition_point(first, last, [c](const NumberSpan& span) {
+                return span.colEnd + 1 <= c;
+            });
+            for (; it != last && it->colBegin <= c + 1; ++it)
+            {
+                result.push_back(it->value);
+            }
         }
-        const auto& nRows = numRows();
-        const auto& nCols = numCols();
-        int result = 0;
-        int lastAddedId = -1;
-        for (auto i = 0; i < nRows; ++i)
+        return result;
+    }
+
+private:
+    std::string grid;
+    size_t nRows {0};
+    size_t nCols {0};
+    bool indexed {false};
+    std::vector<NumberSpan> spans;
+    // Spans of row r are [rowSpans[r], rowSpans[r + 1])
+    std::vector<size_t> rowSpans;
+    // Symbol positions dilated by one cell, wordsPerRow bits words per row
+    std::vector<uint64> nearSymbol;
+    size_t wordsPerRow {0};
+
+    size_t bandCount(size_t nThreads) const
+    {
+        return std::max<size_t>(1, std::min(nThreads, nRows));
+    }
+
+    std::pair<size_t, size_t> bandRows(size_t band, size_t nBands) const
+    {
+        return {nRows * band / nBands, nRows * (band + 1) / nBands};
+    }
+
+    void indexRow(size_t r, uint64* rowSymbols, std::vector<NumberSpan>& rowSpansOut) const
+    {
+        const char* row = grid.data() + r * nCols;
+        std::optional<NumberSpan> current;
+        for (size_t offset = 0; offset < nCols; offset += SIMD_BLOCK)
         {
-            const auto& row = data[i];
-            for (auto j = 0; j < nCols; ++j)
+            const size_t size = std::min(SIMD_BLOCK, nCols - offset);
+            const uint32 digits = digitMask(row + offset, size);
+            const uint32 empties = eqMask(row + offset, '.', size);
+            rowSymbols[offset / 64] |=
+                static_cast<uint64>(blockBits(size) & ~(digits | empties)) << (offset % 64);
+            for (size_t i = 0; i < size; ++i)
             {
-                const auto& element = row[j];
-                if (std::holds_alternative<char>(element) && std::get<char>(element) == '*')
+                const auto c = static_cast<uint32>(offset + i);
+                if (digits >> i & 1)
                 {
-                    auto connectedNums = getConnectedNums(i, j, nRows, nCols);
-                    if (connectedNums.size() < 2)
-                    {
-                        continue;
-                    }
-                    else if (connectedNums.size() > 2)
+                    if (!current)
                     {
-                        std::cout << "Error: more than 2 connected numbers" << std::endl;
-                        return -1;
+                        current = NumberSpan{static_cast<uint32>(r), c, c, 0};
                     }
-                    result += connectedNums[0] * connectedNums[1];
+                    current->value = current->value * 10 + (row[c] - '0');
+                    current->colEnd = c + 1;
+                }
+                else if (current)
+                {
+                    rowSpansOut.push_back(*current);
+                    current.reset();
                 }
             }
         }
-        return result;
+        if (current)
+        {
+            rowSpansOut.push_back(*current);
+        }
     }
 
-    std::vector<int> getConnectedNums(int r, int c, int nRows, int nCols)
+    // Sum of the gear ratios of the rows [first, last), nullopt if a gear is invalid
+    std::optional<int64> sumGearsInRows(size_t first, size_t last) const
     {
-        std::vector<int> connectedIds;
-        for (int toCheckRow = -1 ; toCheckRow <= 1; ++toCheckRow)
+        int64 result = 0;
+        for (size_t r = first; r < last; ++r)
         {
-            for (int toCheckCol = -1; toCheckCol <= 1; ++toCheckCol)
+            const std::string_view row(grid.data() + r * nCols, nCols);
+            for (size_t c = row.find('*'); c != std::string_view::npos; c = row.find('*', c + 1))
             {
-                const auto& row = r + toCheckRow;
-                const auto& col = c + toCheckCol;
-                if (row >= 0 && row < nRows && col >= 0 && col < nCols)
+                auto connectedNums = getConnectedNums(r, c);
+                if (connectedNums.size() < 2)
                 {
-                    const auto& numId = fullNumIds[row][col];
-                    if (numId != -1)
-                    {
-                        connectedIds.push_back(numId);
-                    }
+                    continue;
+                }
+                else if (connectedNums.size() > 2)
+                {
+                    return std::nullopt;
                 }
+                result += connectedNums[0] * connectedNums[1];
             }
         }
+        return result;
+    }
 
-        std::ranges::sort(connectedIds);
-        auto last = std::ranges::unique(connectedIds);
-        connectedIds.erase(last.begin(), connectedIds.end());
+    std::vector<uint64> dilate(const std::vector<uint64>& symbols, size_t nThreads) const
+    {
+        std::vector<uint64> horizontal(symbols.size(), 0);
+        parallel_for(nRows, [&](size_t r) {
+            const uint64* in = symbols.data() + r * wordsPerRow;
+            uint64* out = horizontal.data() + r * wordsPerRow;
+            for (size_t w = 0; w < wordsPerRow; ++w)
+            {
+                out[w] = in[w] | in[w] << 1 | in[w] >> 1;
+                if (w > 0)
+                {
+                    out[w] |= in[w - 1] >> 63;
+                }
+                if (w + 1 < wordsPerRow)
+                {
+                    out[w] |= in[w + 1] << 63;
+                }
+            }
+        }, nThreads);
+        std::vector<uint64> result(horizontal);
+        parallel_for(nRows, [&](size_t r) {
+            for (size_t w = 0; w < wordsPerRow; ++w)
+            {
+                if (r > 0)
+                {
+                    result[r * wordsPerRow + w] |= horizontal[(r - 1) * wordsPerRow + w];
+                }
+                if (r + 1 < nRows)
+                {
+                    result[r * wordsPerRow + w] |= horizontal[(r + 1) * wordsPerRow + w];
+                }
+            }
+        }, nThreads);
+        return result;
+    }
 
-        std::vector<int> result;
-        for (const auto& id : connectedIds)
+    bool isNearSymbol(const NumberSpan& span) const
+    {
+        const uint64* row = nearSymbol.data() + span.row * wordsPerRow;
+        for (size_t c = span.colBegin; c < span.colEnd; ++c)
         {
-            result.push_back(fullNums[id]);
+            if (row[c / 64] >> (c % 64) & 1)
+            {
+                return true;
+            }
         }
-        return result;
+        return false;
     }
+};
 
-private:
-    std::vector<std::vector<Element>> data;
-    std::vector<std::vector<int>> fullNumIds;
-    std::vector<int> fullNums;
 
-    bool isValidPosition(int r, int c, int nRows, int nCols)
+struct SchematicItem
+{
+    enum Kind
     {
-        bool isValid = false;
-        for (int toCheckRow = -1 ; toCheckRow <= 1; ++toCheckRow)
+        PART_NUMBER,
+        GEAR_RATIO
+    };
+
+    Kind kind;
+    int64 value;
+};
+
+bool isSymbol(char c)
+{
+    return c != '.' && !std::isdigit(c);
+}
+
+// Value of the number that has a digit at col
+int64 numberAt(const std::string& row, size_t col)
+{
+    size_t begin = col;
+    while (begin > 0 && std::isdigit(row[begin - 1]))
+    {
+        --begin;
+    }
+    int64 value = 0;
+    for (size_t c = begin; c < row.size() && std::isdigit(row[c]); ++c)
+    {
+        value = value * 10 + (row[c] - '0');
+    }
+    return value;
+}
+
+/*
+ * Appends the part numbers and gear ratios found in row, looking only at the
+ * rows right above and below it (null at the edges of the schematic).
+ */
+void scanRow(const std::string* above,
+             const std::string& row,
+             const std::string* below,
+             std::vector<SchematicItem>& items)
+{
+    const std::array<const std::string*, 3> window {above, &row, below};
+    const size_t nCols = row.size();
+    for (size_t c = 0; c < nCols; ++c)
+    {
+        if (std::isdigit(row[c]))
         {
-            for (int toCheckCol = -1; toCheckCol <= 1; ++toCheckCol)
+            const size_t begin = c;
+            while (c < nCols && std::isdigit(row[c]))
             {
-                const auto& row = r + toCheckRow;
-                const auto& col = c + toCheckCol;
-                if (row >= 0 && row < nRows && col >= 0 && col < nCols)
+                ++c;
+            }
+            const size_t first = begin == 0 ? 0 : begin - 1;
+            const size_t last = std::min(c, nCols - 1);
+            const bool nearSymbol = std::ranges::any_of(window, [first, last](const std::string* r) {
+                return r && std::any_of(r->begin() + first, r->begin() + last + 1, isSymbol);
+            });
+            if (nearSymbol)
+            {
+                items.push_back({SchematicItem::PART_NUMBER, numberAt(row, begin)});
+            }
+            --c;
+        }
+        else if (row[c] == '*')
+        {
+            std::vector<int64> connectedNums;
+            for (const std::string* r : window)
+            {
+                if (!r)
                 {
-                    const auto& element = data[row][col];
-                    isValid = isValid || std::holds_alternative<char>(element);
+                    continue;
+                }
+                const size_t first = c == 0 ? 0 : c - 1;
+                for (size_t col = first; col <= std::min(c + 1, nCols - 1); ++col)
+                {
+                    if (std::isdigit((*r)[col]) && (col == first || !std::isdigit((*r)[col - 1])))
+                    {
+                        connectedNums.push_back(numberAt(*r, col));
+                    }
                 }
             }
+            if (connectedNums.size() > 2)
+            {
+                std::cout << "Error: more than 2 connected numbers" << std::endl;
+            }
+            else if (connectedNums.size() == 2)
+            {
+                items.push_back({SchematicItem::GEAR_RATIO, connectedNums[0] * connectedNums[1]});
+            }
         }
-        return isValid;
     }
-};
+}
 
+/*
+ * Streaming solver for schematics too tall to keep in memory. Only the rows
+ * above, at and below the one being scanned are stored, and its part numbers
+ * and gear ratios are yielded as soon as the row below it is read.
+ */
+template<std::ranges::input_range Lines>
+Generator<SchematicItem> streamSchematic(Lines lines)
+{
+    std::array<std::string, 3> window;
+    std::vector<SchematicItem> items;
+    size_t nRows = 0;
+    for (const auto line : lines)
+    {
+        std::ranges::rotate(window, window.begin() + 1);
+        window[2].assign(line);
+        if (++nRows < 2)
+        {
+            continue;
+        }
+        items.clear();
+        scanRow(nRows > 2 ? &window[0] : nullptr, window[1], &window[2], items);
+        for (const auto& item : items)
+        {
+            co_yield item;
+        }
+    }
+    if (nRows > 0)
+    {
+        items.clear();
+        scanRow(nRows > 1 ? &window[1] : nullptr, window[2], nullptr, items);
+        for (const auto& item : items)
+        {
+            co_yield item;
+        }
+    }
+}
 
-int main() {
+int streamingMain()
+{
     std::ifstream file("input.txt");
+    if (!file) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
+
+    std::array<int64, 2> result {0, 0};
+    for (const auto& item : streamSchematic(lines(file))) {
+        result[item.kind] += item.value;
+    }
+
+    std::cout << "Part 1: " << result[SchematicItem::PART_NUMBER] << '\n';
+    std::cout << "Part 2: " << result[SchematicItem::GEAR_RATIO] << '\n';
+
+    return 0;
+}
+
+
+/*
+ * Usage: main [--stream]
+ * With --stream the schematic is read row by row with a three row window.
+ */
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "--stream") {
+        return streamingMain();
+    }
 
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
     Array data {};
-    std::string line;
-    while (std::getline(file, line)) {
+    for (const auto line : lines(file.view())) {
         data.addRow(line);
     }
 
-    std::cout << "Part 1: " << data.sumValidNumbers() << '\n';
-    std::cout << "Part 2: " << data.sumConnectedToGears() << '\n';
+    const size_t nThreads = defaultThreadCount();
+    std::cout << "Part 1: " << data.sumValidNumbers(nThreads) << '\n';
+    std::cout << "Part 2: " << data.sumConnectedToGears(nThreads) << '\n';
 
     return 0;
 }
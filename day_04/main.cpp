@@ -1,113 +1,233 @@
 #include <algorithm>
-#include <fstream>
-#include <numeric>
-#include <ranges>
-#include <string>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <string_view>
 #include <iostream>
+#include <optional>
+#include <string>
 #include "../utils.hpp"
 
 
+// Set of card numbers (0..127) as a 128-bit mask split in two words
+using CardNumbers = std::array<uint64, 2>;
+constexpr int MAX_CARD_NUMBER = 127;
+
+// nullopt when the score does not fit in 64 bits, i.e. for more than 64 wins
+std::optional<uint64> scoreFromWins(int wins)
+{
+    if (wins > 64)
+        return std::nullopt;
+    return wins == 0 ? 0 : uint64 {1} << (wins - 1);
+}
+
+/*
+ * A card is parsed straight into two bitsets, so the number of wins is the
+ * popcount of their intersection. Repeated played numbers count only once,
+ * which never happens in the inputs. Numbers outside 0..127 are reported on
+ * stderr and leave the card not well formed.
+ */
 class Game {
 public:
-    Game(const std::string& line)
+    Game(std::string_view line)
     {
-        auto lineSpl = split(line, ": ");
-        gameId = std::stoi(split(lineSpl[0], " ")[1]);
-        auto numsPart = split(lineSpl[1], " | ");
-        auto winningNumsVec = split(numsPart[0], " ");
-        auto playingNumsVec = split(numsPart[1], " ");
-        for (auto& num : winningNumsVec) {
-            winningNums.push_back(std::stoi(num));
-        }
-        for (auto& num : playingNumsVec) {
-            playingNums.push_back(std::stoi(num));
+        const char* it = line.data();
+        const char* const last = line.data() + line.size();
+        it = std::from_chars(skipToDigit(it, last), last, gameId).ptr;
+        CardNumbers* numbers = &winningNums;
+        for (; it != last; ++it) {
+            if (*it == '|') {
+                numbers = &playingNums;
+            }
+            else if (std::isdigit(*it)) {
+                int num = 0;
+                const auto [numEnd, error] = std::from_chars(it, last, num);
+                if (error != std::errc {} || num > MAX_CARD_NUMBER) {
+                    std::cerr << "Invalid card number in: " << line << '\n';
+                    wellFormed = false;
+                    return;
+                }
+                it = numEnd - 1;
+                (*numbers)[num / 64] |= uint64 {1} << (num % 64);
+            }
         }
-        std::ranges::sort(winningNums);
     }
 
+    bool isWellFormed() const { return wellFormed; }
+
     int getGameId() const { return gameId; }
 
+    const CardNumbers& getWinningNums() const { return winningNums; }
+
+    const CardNumbers& getPlayingNums() const { return playingNums; }
+
     int getNumWins() const
     {
-        return std::count_if(playingNums.begin(), playingNums.end(), [this](int num) {
-            return std::binary_search(winningNums.begin(), winningNums.end(), num);
-        });
+        return std::popcount(winningNums[0] & playingNums[0]) +
+               std::popcount(winningNums[1] & playingNums[1]);
     }
 
-    int score() const
+    std::optional<uint64> score() const
     {
-        int wins = getNumWins();
-
-        if (wins == 0) {
-            return 0;
-        }
-        return std::pow(2, wins - 1);
+        return scoreFromWins(getNumWins());
     }
 
 private:
-    int gameId;
-    std::vector<int> winningNums;
-    std::vector<int> playingNums;
+    int gameId {0};
+    CardNumbers winningNums {0, 0};
+    CardNumbers playingNums {0, 0};
+    bool wellFormed {true};
 
+    static const char* skipToDigit(const char* it, const char* last)
+    {
+        while (it != last && !std::isdigit(*it)) {
+            ++it;
+        }
+        return it;
+    }
 };
 
-class Maze {
+/*
+ * Cards stored as structure of arrays so the wins of four cards are computed
+ * per AVX2 instruction: AND of the bitsets and a nibble lookup popcount.
+ */
+class CardBatch {
 public:
-    Maze() = default;
+    void add(const Game& game)
+    {
+        for (size_t w = 0; w < 2; ++w) {
+            winning[w].push_back(game.getWinningNums()[w]);
+            playing[w].push_back(game.getPlayingNums()[w]);
+        }
+    }
+
+    size_t size() const { return winning[0].size(); }
 
-    void addGame(const Game& game)
+    void clear()
     {
-        games.push_back(game);
-        winningNums.push_back(game.getNumWins());
-        generatedCards.push_back(0);
+        for (size_t w = 0; w < 2; ++w) {
+            winning[w].clear();
+            playing[w].clear();
+        }
     }
 
-    void computeGeneratedCards()
+    std::vector<int> countWins() const
     {
-        // We know the last generates 0
-        const int numGames = games.size();
-        generatedCards[numGames - 1] = 1;
-        for (int i : std::views::iota(0, numGames - 1) | std::views::reverse) {
-            const auto& game = games[i];
-            const int numWins = winningNums[i];
-            int generatedCard = 0;
-            for (int j : std::views::iota(1, numWins + 1)) {
-                generatedCard += generatedCards[i + j];
+        std::vector<int> result(size());
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+        auto load = [](const std::vector<uint64>& v, size_t i) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v.data() + i));
+        };
+        auto popcount8 = [&](__m256i x) {
+            const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, lowNibble));
+            const __m256i high =
+                _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowNibble));
+            return _mm256_add_epi8(low, high);
+        };
+        for (; i + 4 <= size(); i += 4) {
+            const __m256i common0 = _mm256_and_si256(load(winning[0], i), load(playing[0], i));
+            const __m256i common1 = _mm256_and_si256(load(winning[1], i), load(playing[1], i));
+            // Byte counts of both words, summed per 64-bit lane
+            const __m256i counts = _mm256_sad_epu8(
+                _mm256_add_epi8(popcount8(common0), popcount8(common1)), _mm256_setzero_si256());
+            alignas(32) std::array<uint64, 4> lanes;
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes.data()), counts);
+            for (size_t lane = 0; lane < 4; ++lane) {
+                result[i + lane] = static_cast<int>(lanes[lane]);
             }
-            generatedCards[i] = generatedCard + 1;
         }
+#endif
+        for (; i < size(); ++i) {
+            result[i] = std::popcount(winning[0][i] & playing[0][i]) +
+                        std::popcount(winning[1][i] & playing[1][i]);
+        }
+        return result;
     }
 
-    int getNumberOfScratchCards()
+private:
+    std::array<std::vector<uint64>, 2> winning;
+    std::array<std::vector<uint64>, 2> playing;
+};
+
+/*
+ * Part 2 as a stream: every card is consumed once, in order. The copies won by
+ * a card are added to the following numWins cards through a difference array
+ * kept in a ring buffer, so only the pending counts of the next cards are
+ * stored. A card holds at most 128 numbers, which bounds the ring size.
+ */
+class CardCascade {
+public:
+    static constexpr size_t RING_SIZE = 256;
+
+    // Returns the total number of copies held of the added card
+    uint64 addCard(int numWins)
     {
-        computeGeneratedCards();
-        return std::accumulate(generatedCards.begin(), generatedCards.end(), 0);
+        assert(numWins >= 0 && static_cast<size_t>(numWins) < RING_SIZE - 1);
+        auto& delta = pending[current % RING_SIZE];
+        running += delta;
+        delta = 0;
+        const uint64 copies = 1 + running;
+        if (numWins > 0) {
+            pending[(current + 1) % RING_SIZE] += copies;
+            pending[(current + numWins + 1) % RING_SIZE] -= copies;
+        }
+        ++current;
+        totalCards += copies;
+        return copies;
     }
 
+    uint64 getNumberOfScratchCards() const { return totalCards; }
 
 private:
-    std::vector<Game> games;
-    std::vector<int> winningNums;
-    std::vector<int> generatedCards;
+    // Differences are added and removed in unsigned wrapping arithmetic
+    std::array<uint64, RING_SIZE> pending {};
+    uint64 running {0};
+    uint64 current {0};
+    uint64 totalCards {0};
 };
 
 int main() {
-    std::ifstream file("input.txt");
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
-    std::string line;
-    int part1 = 0;
-    Maze maze {};
-    while (std::getline(file, line)) {
-        Game game(line);
-        part1 += game.score();
-        maze.addGame(game);
+    // Cards are scored a batch at a time so the whole input is never held
+    constexpr size_t BATCH_SIZE = 4096;
+    CardBatch cards;
+    CardCascade cascade;
+    // nullopt once the total no longer fits in 64 bits
+    std::optional<uint64> part1 = 0;
+    auto flush = [&]() {
+        for (const int wins : cards.countWins()) {
+            const auto score = scoreFromWins(wins);
+            if (part1 && (!score || __builtin_add_overflow(*part1, *score, &*part1))) {
+                part1.reset();
+            }
+            cascade.addCard(wins);
+        }
+        cards.clear();
+    };
+    for (const auto line : lines(file.view())) {
+        const Game game(line);
+        if (!game.isWellFormed()) {
+            return 1;
+        }
+        cards.add(game);
+        if (cards.size() == BATCH_SIZE) {
+            flush();
+        }
     }
+    flush();
 
-    std::cout << "Part 1: " << part1 << "\n";
-    std::cout << "Part 2: " << maze.getNumberOfScratchCards() << "\n";
+    std::cout << "Part 1: " << (part1 ? std::to_string(*part1) : "overflow") << "\n";
+    std::cout << "Part 2: " << cascade.getNumberOfScratchCards() << "\n";
     return 0;
 }
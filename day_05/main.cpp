@@ -3,6 +3,8 @@
 #include <array>
 #include <cstdio>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <optional>
 #include <string>
 #include <iostream>
@@ -65,6 +67,54 @@ std::ostream& operator<<(std::ostream& os, const Range& range)
     return os << "[" << range.start << ", " << range.end() << ")";
 }
 
+// Sorts the ranges and merges the ones that overlap or touch
+void coalesce(std::vector<Range>& ranges)
+{
+    std::ranges::sort(ranges, {}, &Range::start);
+    size_t last = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].start <= ranges[last].end()) {
+            const ulint end = std::max(ranges[last].end(), ranges[i].end());
+            ranges[last].range = end - ranges[last].start;
+        }
+        else {
+            ranges[++last] = ranges[i];
+        }
+    }
+    if (!ranges.empty()) {
+        ranges.resize(last + 1);
+    }
+}
+
+/*
+ * Number of seed range fragments after each stage, before and after
+ * coalescing them.
+ */
+struct PropagationStats
+{
+    std::vector<size_t> mapped;
+    std::vector<size_t> coalesced;
+
+    void add(const PropagationStats& other)
+    {
+        mapped.resize(std::max(mapped.size(), other.mapped.size()), 0);
+        coalesced.resize(mapped.size(), 0);
+        for (size_t i = 0; i < other.mapped.size(); ++i) {
+            mapped[i] += other.mapped[i];
+            coalesced[i] += other.coalesced[i];
+        }
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const PropagationStats& stats)
+{
+    for (size_t i = 0; i < stats.mapped.size(); ++i) {
+        os << "Stage " << i + 1 << ": " << stats.mapped[i] << " fragments, "
+           << stats.coalesced[i] << " after coalescing\n";
+    }
+    return os;
+}
+
 class TypeFullMap
 {
 public:
@@ -72,68 +122,80 @@ public:
 
     void addRange(ulint keyMin, ulint valMin, ulint range)
     {
-        ranges.insert(ranges.begin(), {keyMin, valMin, range});
+        ranges.push_back({keyMin, valMin, range});
+        keyMins.clear();
     }
 
-    ulint getValue(ulint key) const
+    const std::vector<RangeMap>& getRanges() const { return ranges; }
+
+    // Sorts the ranges by key and builds the lookup index of their starts
+    void sortRanges()
     {
+        std::ranges::sort(ranges, {}, &RangeMap::keyMin);
+        keyMins.clear();
+        keyMins.reserve(ranges.size());
         for (const auto& range : ranges) {
-            if (range.contains(key)) {
-                return range.getVal(key);
-            }
+            keyMins.push_back(range.keyMin);
+        }
+#ifndef NDEBUG
+        validate();
+#endif
+    }
+
+    bool isSorted() const { return keyMins.size() == ranges.size(); }
+
+    ulint getValue(ulint key) const
+    {
+        assert(isSorted());
+        const size_t i = findRange(key);
+        if (i < ranges.size() && ranges[i].contains(key)) {
+            return ranges[i].getVal(key);
         }
         return key;
     }
 
-    std::vector<Range> getValue(const Range& keyRange) const
+    // Appends the image of keyRange, split at the boundaries of the ranges
+    void getValue(const Range& keyRange, std::vector<Range>& result) const
     {
-        std::vector<Range> result;
-        std::vector<Range> remainingRanges = {keyRange};
-
-        while (remainingRanges.size())
-        {
-            Range currentRange = remainingRanges.back();
-            remainingRanges.pop_back();
-            bool hasIntersection = false;
-            for (const auto& range : ranges) {
-                if (!range.getKeyRange().intersection(currentRange)) {
-                    continue;
-                }
-                hasIntersection = true;
-                const auto subRanges = range.getVal(currentRange);
-                if (subRanges[0].range)
-                {
-                    remainingRanges.push_back(subRanges[0]);
-                }
-                if (subRanges[2].range)
-                {
-                    remainingRanges.push_back(subRanges[2]);
-                }
-                result.push_back(subRanges[1]);
+        assert(isSorted());
+        ulint key = keyRange.start;
+        const ulint end = keyRange.end();
+        size_t i = findRange(key);
+        if (i == ranges.size()) {
+            i = 0;
+        }
+        while (key < end) {
+            if (i == ranges.size() || ranges[i].keyMin >= end) {
+                result.push_back({key, end - key});
                 break;
             }
-            if (!hasIntersection) {
-                result.push_back(currentRange);
+            const auto& range = ranges[i++];
+            const ulint rangeEnd = range.keyMin + range.range;
+            if (rangeEnd <= key) {
+                continue;
+            }
+            if (range.keyMin > key) {
+                result.push_back({key, range.keyMin - key});
+                key = range.keyMin;
             }
+            const ulint pieceEnd = std::min(end, rangeEnd);
+            result.push_back({range.getVal(key), pieceEnd - key});
+            key = pieceEnd;
         }
-        return result;
     }
 
-    void onlyInOneRange(ulint key) const
+    // Every key must be in at most one range, checked once per stage in debug builds
+    void validate() const
     {
-        int count = 0;
-        for (const auto& range : ranges) {
-            if (range.contains(key)) {
-                count++;
-            }
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            assert(ranges[i - 1].keyMin + ranges[i - 1].range <= ranges[i].keyMin);
         }
-        assert(count == 1 || count == 0);
     }
 
     void transform(std::vector<ulint>& type) const
     {
+        assert(isSorted());
         for (auto& val : type) {
-            onlyInOneRange(val);
             val = getValue(val);
         }
     }
@@ -141,112 +203,348 @@ public:
     void transform(std::vector<Range>& typeRanges) const
     {
         std::vector<Range> result;
+        result.reserve(typeRanges.size());
         for (const auto& valRange : typeRanges) {
-            std::vector<Range> mappedRange = getValue(valRange);
-            result.insert(result.end(), mappedRange.begin(), mappedRange.end());
+            getValue(valRange, result);
         }
-        typeRanges = result;
+        typeRanges = std::move(result);
     }
 
-    void clear() { ranges.clear(); }
+    void clear()
+    {
+        ranges.clear();
+        keyMins.clear();
+    }
 
 private:
     std::vector<RangeMap> ranges;
+    // Starts of the sorted ranges, kept apart so the search only touches keys
+    std::vector<ulint> keyMins;
+
+    // Index of the last range starting at or before key, ranges.size() if none.
+    // Branchless binary search: the loop length only depends on the size.
+    size_t findRange(ulint key) const
+    {
+        if (keyMins.empty() || key < keyMins[0]) {
+            return ranges.size();
+        }
+        const ulint* base = keyMins.data();
+        for (size_t n = keyMins.size(); n > 1;) {
+            const size_t half = n / 2;
+            base = base[half] <= key ? base + half : base;
+            n -= half;
+        }
+        return base - keyMins.data();
+    }
 };
 
 
-ulint part1()
+/*
+ * Piecewise-linear map over the whole key domain: keys in
+ * [starts[i], starts[i + 1]) are mapped to key + deltas[i]. Deltas are applied
+ * with unsigned wrapping arithmetic, so they also encode negative shifts.
+ * Keys are assumed to stay below DOMAIN_END.
+ */
+class PiecewiseMap
 {
-    std::ifstream file(INPUT_FILE);
-    if (!file) {
-        std::cerr << "Error opening file\n";
-        return 1;
+public:
+    static constexpr ulint DOMAIN_END = std::numeric_limits<ulint>::max();
+
+    // Identity map
+    PiecewiseMap() : starts{0}, deltas{0} {}
+
+    explicit PiecewiseMap(std::vector<RangeMap> ranges)
+    {
+        std::ranges::sort(ranges, {}, &RangeMap::keyMin);
+        ulint position = 0;
+        for (const auto& range : ranges) {
+            if (range.range == 0) {
+                continue;
+            }
+            assert(range.keyMin >= position);
+            if (range.keyMin > position) {
+                push(position, 0);
+            }
+            push(range.keyMin, range.valMin - range.keyMin);
+            position = range.keyMin + range.range;
+        }
+        push(position, 0);
     }
 
-    std::string line;
-    std::getline(file, line);
-    std::vector<ulint> originalType;
-    auto lineSplit = split(split(line, ": ")[1]);
-    for (const auto& seed : lineSplit) {
-        originalType.push_back(std::stoul(seed));
+    ulint operator()(ulint key) const { return key + deltas[segmentOf(key)]; }
+
+    // Map equivalent to applying this one and then next
+    PiecewiseMap andThen(const PiecewiseMap& next) const
+    {
+        PiecewiseMap result {{}, {}};
+        for (size_t i = 0; i < starts.size(); ++i) {
+            const ulint end = segmentEnd(i);
+            const ulint delta = deltas[i];
+            // Split the segment where its image crosses a breakpoint of next
+            for (ulint key = starts[i]; key < end;) {
+                const size_t j = next.segmentOf(key + delta);
+                const ulint nextEnd = next.segmentEnd(j) - delta;
+                result.push(key, delta + next.deltas[j]);
+                key = nextEnd > key && nextEnd < end ? nextEnd : end;
+            }
+        }
+        return result;
     }
 
-    std::getline(file, line);
-    assert(line == "");
+    // Lowest value in the image of the keys of range
+    ulint minImage(const Range& range) const
+    {
+        ulint result = DOMAIN_END;
+        if (range.range == 0) {
+            return result;
+        }
+        for (size_t i = segmentOf(range.start); i < starts.size() && starts[i] < range.end(); ++i) {
+            result = std::min(result, std::max(starts[i], range.start) + deltas[i]);
+        }
+        return result;
+    }
 
-    TypeFullMap typeMap;
+    size_t size() const { return starts.size(); }
 
-    while (std::getline(file, line)) {
-        if (line == "") {
-            typeMap.transform(originalType);
-            typeMap.clear();
-            continue;
+private:
+    std::vector<ulint> starts;
+    std::vector<ulint> deltas;
+
+    PiecewiseMap(std::vector<ulint> starts, std::vector<ulint> deltas) :
+        starts(std::move(starts)),
+        deltas(std::move(deltas))
+    {}
+
+    size_t segmentOf(ulint key) const
+    {
+        return std::ranges::upper_bound(starts, key) - starts.begin() - 1;
+    }
+
+    ulint segmentEnd(size_t i) const { return i + 1 < starts.size() ? starts[i + 1] : DOMAIN_END; }
+
+    // Appends a segment starting at start, merging it with the last one if possible
+    void push(ulint start, ulint delta)
+    {
+        if (!starts.empty() && starts.back() == start) {
+            deltas.back() = delta;
         }
-        if (line.contains("-to-"))
-        {
-            continue;
+        else if (deltas.empty() || deltas.back() != delta) {
+            starts.push_back(start);
+            deltas.push_back(delta);
         }
-        auto lineSplit = split(line);
-        assert(lineSplit.size() == 3);
-        ulint valueOrigin = std::stoul(lineSplit[0]);
-        ulint keyOrigin = std::stoul(lineSplit[1]);
-        ulint nElements = std::stoul(lineSplit[2]);
-        typeMap.addRange(keyOrigin, valueOrigin, nElements);
     }
-    typeMap.transform(originalType);
+};
 
-    return std::ranges::min(originalType);
-}
 
-ulint part2()
+/*
+ * Seeds and stage maps of an almanac, parsed once and shared by both parts and
+ * by any number of seed sets queried against it. The stages are also composed
+ * into a single seed-to-location map at construction.
+ */
+class Almanac
 {
-    std::ifstream file(INPUT_FILE);
-    if (!file) {
-        std::cerr << "Error opening file\n";
-        return 1;
+public:
+    explicit Almanac(std::string_view text)
+    {
+        TypeFullMap typeMap;
+        auto finishStage = [&]() {
+            typeMap.sortRanges();
+            seedToLocation = seedToLocation.andThen(PiecewiseMap(typeMap.getRanges()));
+            stages.push_back(std::move(typeMap));
+            typeMap.clear();
+        };
+
+        for (const auto line : lines(text)) {
+            if (line.starts_with("seeds:")) {
+                for (const ulint seed : numbers(line)) {
+                    seeds.push_back(seed);
+                }
+                continue;
+            }
+            if (line == "") {
+                if (!stages.empty() || !typeMap.getRanges().empty()) {
+                    finishStage();
+                }
+                continue;
+            }
+            if (line.contains("-to-"))
+            {
+                continue;
+            }
+            std::array<ulint, 3> values;
+            size_t nValues = 0;
+            for (const ulint value : numbers(line)) {
+                assert(nValues < values.size());
+                values[nValues++] = value;
+            }
+            assert(nValues == 3);
+            const auto [valueOrigin, keyOrigin, nElements] = values;
+            typeMap.addRange(keyOrigin, valueOrigin, nElements);
+        }
+        finishStage();
     }
 
-    std::string line;
-    std::getline(file, line);
-    std::vector<Range> seedRanges;
-    auto lineSplit = split(split(line, ": ")[1]);
-    int seedPairs = lineSplit.size() / 2;
-    for (int i = 0; i < seedPairs; ++i) {
-        ulint start = std::stoul(lineSplit[i * 2]);
-        ulint range = std::stoul(lineSplit[i * 2 + 1]);
-        seedRanges.push_back({ start, range });
+    const std::vector<ulint>& getSeeds() const { return seeds; }
+
+    size_t numStages() const { return stages.size(); }
+
+    // Seeds read as (start, length) pairs, as in part 2
+    static std::vector<Range> toRanges(const std::vector<ulint>& seeds)
+    {
+        std::vector<Range> result;
+        for (size_t i = 0; i + 1 < seeds.size(); i += 2) {
+            result.push_back({seeds[i], seeds[i + 1]});
+        }
+        return result;
     }
 
-    std::getline(file, line);
-    assert(line == "");
+    // When staged the maps are applied one stage at a time instead of composed
+    ulint lowestLocation(std::vector<ulint> seedSet, bool staged = false) const
+    {
+        if (staged) {
+            for (const auto& stage : stages) {
+                stage.transform(seedSet);
+            }
+            return std::ranges::min(seedSet);
+        }
+        return std::ranges::min(seedSet | std::views::transform(std::cref(seedToLocation)));
+    }
 
-    TypeFullMap typeMap;
+    /*
+     * The seed ranges are split into one chunk per thread. Each chunk is
+     * propagated on its own (coalescing the fragments after every stage when
+     * staged) and the chunk minima are reduced at the end.
+     */
+    ulint lowestLocation(const std::vector<Range>& seedRanges,
+                         bool staged = false,
+                         size_t nThreads = 1,
+                         PropagationStats* stats = nullptr) const
+    {
+        const size_t nChunks = std::max<size_t>(1, std::min(nThreads, seedRanges.size()));
+        std::vector<ulint> chunkMins(nChunks, PiecewiseMap::DOMAIN_END);
+        std::vector<PropagationStats> chunkStats(nChunks);
+        parallel_for(nChunks, [&](size_t chunk) {
+            const auto first = seedRanges.begin() + seedRanges.size() * chunk / nChunks;
+            const auto last = seedRanges.begin() + seedRanges.size() * (chunk + 1) / nChunks;
+            if (!staged) {
+                for (auto it = first; it != last; ++it) {
+                    chunkMins[chunk] = std::min(chunkMins[chunk], seedToLocation.minImage(*it));
+                }
+                return;
+            }
+            std::vector<Range> fragments(first, last);
+            for (const auto& stage : stages) {
+                stage.transform(fragments);
+                chunkStats[chunk].mapped.push_back(fragments.size());
+                coalesce(fragments);
+                chunkStats[chunk].coalesced.push_back(fragments.size());
+            }
+            if (!fragments.empty()) {
+                // Coalesced fragments are sorted by start
+                chunkMins[chunk] = fragments.front().start;
+            }
+        }, nThreads);
+        if (stats) {
+            for (const auto& chunkStat : chunkStats) {
+                stats->add(chunkStat);
+            }
+        }
+        return std::ranges::min(chunkMins);
+    }
 
-    while (std::getline(file, line)) {
-        if (line == "") {
-            typeMap.transform(seedRanges);
-            typeMap.clear();
+private:
+    std::vector<ulint> seeds;
+    std::vector<TypeFullMap> stages;
+    PiecewiseMap seedToLocation;
+};
+
+/*
+ * Every line of the file is a seed set. Prints, per line, the lowest location
+ * reading the seeds as points (part 1) and as ranges (part 2). A set without a
+ * complete (start, length) pair has no part 2 answer and prints "-" for it.
+ */
+int answerSeedSets(const Almanac& almanac, const std::string& path, bool staged)
+{
+    const MappedFile file(path);
+    if (!file) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
+    for (const auto line : lines(file.view())) {
+        std::vector<ulint> seedSet;
+        for (const ulint seed : numbers(line)) {
+            seedSet.push_back(seed);
+        }
+        if (seedSet.empty()) {
             continue;
         }
-        if (line.contains("-to-"))
-        {
+        const auto seedRanges = Almanac::toRanges(seedSet);
+        const ulint lowestPoint = almanac.lowestLocation(std::move(seedSet), staged);
+        if (seedRanges.empty()) {
+            std::printf("%llu -\n", lowestPoint);
             continue;
         }
-        auto lineSplit = split(line);
-        assert(lineSplit.size() == 3);
-        ulint valueOrigin = std::stoul(lineSplit[0]);
-        ulint keyOrigin = std::stoul(lineSplit[1]);
-        ulint nElements = std::stoul(lineSplit[2]);
-        typeMap.addRange(keyOrigin, valueOrigin, nElements);
+        std::printf("%llu %llu\n",
+                    lowestPoint,
+                    almanac.lowestLocation(seedRanges, staged, defaultThreadCount()));
     }
-    typeMap.transform(seedRanges);
-
-    return std::ranges::min(std::ranges::views::all(seedRanges) | std::views::transform([](auto& r) { return r.start; }));
+    return 0;
 }
 
-int main() {
-    std::printf("Part 1: %llu\n", part1());
-    std::printf("Part 2: %llu\n", part2());
+/*
+ * Usage: main [--staged] [--stats] [--seeds FILE]
+ * --staged applies the maps stage by stage instead of composing them.
+ * --stats prints the number of part 2 range fragments after each stage; the
+ *         fragments only exist when propagating stage by stage, so it implies
+ *         --staged for part 2.
+ * --seeds answers every seed set in FILE against the same almanac.
+ */
+int main(int argc, char* argv[]) {
+    bool staged = false;
+    bool showStats = false;
+    std::optional<std::string> seedsPath;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--staged") {
+            staged = true;
+        }
+        else if (arg == "--stats") {
+            showStats = true;
+        }
+        else if (arg == "--seeds" && i + 1 < argc) {
+            seedsPath = argv[++i];
+        }
+    }
+
+    const MappedFile file(INPUT_FILE);
+    if (!file) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
+    const Almanac almanac(file.view());
+    if (seedsPath) {
+        return answerSeedSets(almanac, *seedsPath, staged);
+    }
+
+    if (almanac.getSeeds().empty()) {
+        std::cerr << "No seeds in the almanac\n";
+        return 1;
+    }
+
+    std::printf("Part 1: %llu\n", almanac.lowestLocation(almanac.getSeeds(), staged));
+    const auto seedRanges = Almanac::toRanges(almanac.getSeeds());
+    PropagationStats stats;
+    if (seedRanges.empty()) {
+        // A single seed is not a (start, length) pair, as in answerSeedSets
+        std::printf("Part 2: -\n");
+    }
+    else {
+        std::printf("Part 2: %llu\n",
+                    almanac.lowestLocation(seedRanges, staged || showStats, defaultThreadCount(), &stats));
+    }
+    if (showStats) {
+        std::cerr << stats;
+    }
 
     // 69713834 is too low
     return 0;
@@ -1,72 +1,266 @@
-#include <cassert>
-#include <cmath>
-#include <concepts>
-#include <fstream>
+#include <algorithm>
 #include <array>
-#include <limits>
+#include <cctype>
+#include <cmath>
+#include <compare>
+#include <optional>
+#include <string_view>
 #include <vector>
-#include <string>
 #include <iostream>
 #include "../utils.hpp"
 
 
-template <std::integral T>
-std::array<T, 2> findWaitTimeLimits(T availableTime, T minDistance)
+struct Uint256
+{
+    uint128 high;
+    uint128 low;
+
+    auto operator<=>(const Uint256&) const = default;
+};
+
+Uint256 mulWide(uint128 a, uint128 b)
+{
+    const uint128 mask = ~uint64 {0};
+    const uint128 p00 = (a & mask) * (b & mask);
+    const uint128 p01 = (a & mask) * (b >> 64);
+    const uint128 p10 = (a >> 64) * (b & mask);
+    const uint128 p11 = (a >> 64) * (b >> 64);
+    const uint128 middle = (p00 >> 64) + (p01 & mask) + (p10 & mask);
+    return {p11 + (p01 >> 64) + (p10 >> 64) + (middle >> 64), (p00 & mask) | (middle << 64)};
+}
+
+Uint256 operator+(const Uint256& a, uint128 b)
+{
+    const uint128 low = a.low + b;
+    return {a.high + (low < a.low), low};
+}
+
+/*
+ * Holding the button for h wins when h * (T - h) > D, which is the same as
+ * (2h - T)^2 < T^2 - 4D. The widest k = 2h - T is built bit by bit comparing
+ * exact 256-bit squares, so the bounds are exact for T and D below 2^126 with
+ * no floating point and no correction loops.
+ */
+std::optional<std::array<uint128, 2>> findWaitTimeLimits(uint128 availableTime, uint128 minDistance)
+{
+    const Uint256 timeSq = mulWide(availableTime, availableTime);
+    const uint128 fourDist = minDistance * 4;
+    // The condition only gets harder as |k| grows, so k = 0 must hold for any solution
+    if (!(Uint256 {0, fourDist} < timeSq)) {
+        return std::nullopt;
+    }
+    uint128 halfWidth = 0;
+    for (int bit = 127; bit >= 0; --bit) {
+        const uint128 candidate = halfWidth | uint128 {1} << bit;
+        if (candidate <= availableTime && mulWide(candidate, candidate) + fourDist < timeSq) {
+            halfWidth = candidate;
+        }
+    }
+    // k must have the same parity as T
+    if ((halfWidth ^ availableTime) & 1) {
+        if (halfWidth == 0) {
+            return std::nullopt;
+        }
+        --halfWidth;
+    }
+    return std::array<uint128, 2> {(availableTime - halfWidth) / 2, (availableTime + halfWidth) / 2};
+}
+
+uint128 countWaysToWin(uint128 availableTime, uint128 minDistance)
+{
+    const auto limits = findWaitTimeLimits(availableTime, minDistance);
+    return limits ? (*limits)[1] - (*limits)[0] + 1 : 0;
+}
+
+/*
+ * Structure of arrays batch of independent races. Races whose T^2 - 4D is
+ * exact in a double (T < 2^26, D < 2^50) get their width from a vectorized
+ * sqrt plus an exact integer fix-up of at most one step each way; the rest go
+ * through the exact 128-bit solver.
+ */
+struct RaceBatch
+{
+    static constexpr uint64 FAST_TIME_LIMIT = uint64 {1} << 26;
+    static constexpr uint64 FAST_DIST_LIMIT = uint64 {1} << 50;
+
+    std::vector<uint64> times;
+    std::vector<uint64> distances;
+
+    void add(uint64 time, uint64 distance)
+    {
+        times.push_back(time);
+        distances.push_back(distance);
+    }
+
+    size_t size() const { return times.size(); }
+
+    bool isFast(size_t i) const { return times[i] < FAST_TIME_LIMIT && distances[i] < FAST_DIST_LIMIT; }
+
+    std::vector<uint64> countWaysToWin() const
+    {
+        std::vector<uint64> counts(size());
+        std::vector<double> roots(size());
+        size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 4 <= size(); i += 4) {
+            alignas(32) std::array<double, 4> discr;
+            for (size_t lane = 0; lane < 4; ++lane) {
+                const double time = static_cast<double>(times[i + lane]);
+                discr[lane] = std::max(0.0, time * time - 4.0 * distances[i + lane] - 1.0);
+            }
+            _mm256_storeu_pd(roots.data() + i, _mm256_sqrt_pd(_mm256_load_pd(discr.data())));
+        }
+#endif
+        for (; i < size(); ++i) {
+            const double time = static_cast<double>(times[i]);
+            roots[i] = std::sqrt(std::max(0.0, time * time - 4.0 * distances[i] - 1.0));
+        }
+
+        for (i = 0; i < size(); ++i) {
+            if (!isFast(i)) {
+                counts[i] = static_cast<uint64>(::countWaysToWin(times[i], distances[i]));
+                continue;
+            }
+            const int64 time = static_cast<int64>(times[i]);
+            const int64 discr = time * time - 4 * static_cast<int64>(distances[i]);
+            if (discr <= 0) {
+                counts[i] = 0;
+                continue;
+            }
+            // Largest k with k^2 < discr and the parity of T
+            auto k = static_cast<int64>(roots[i]);
+            if ((k + 1) * (k + 1) < discr) {
+                ++k;
+            }
+            if (k * k >= discr) {
+                --k;
+            }
+            if ((k ^ time) & 1) {
+                --k;
+            }
+            counts[i] = k < 0 ? 0 : static_cast<uint64>(k + 1);
+        }
+        return counts;
+    }
+};
+
+// Product of the counts, nullopt if it does not fit in 128 bits
+std::optional<uint128> checkedProduct(const std::vector<uint64>& counts)
+{
+    if (std::ranges::find(counts, 0) != counts.end()) {
+        return 0;
+    }
+    uint128 result = 1;
+    for (const uint64 count : counts) {
+        if (__builtin_mul_overflow(result, static_cast<uint128>(count), &result)) {
+            return std::nullopt;
+        }
+    }
+    return result;
+}
+
+uint64 productModulo(const std::vector<uint64>& counts, uint64 modulus)
 {
-    if (availableTime < 2*std::sqrt(minDistance)) {
-        std::cerr << "No solution\n";
-        return {0, 0};
-    }
-    float availableTimeSq = static_cast<float>(availableTime);
-    availableTimeSq *= availableTimeSq;
-    float discr = std::sqrt(availableTimeSq - 4*minDistance);
-    T lower = std::ceil((availableTime - discr) / 2.f);
-    T upper = std::floor((availableTime + discr) / 2.f);
-    T lowerVal = (availableTime - lower) * lower;
-    // Adjust the result due to floating point errors
-    while((availableTime - lower) * lower <= minDistance) { ++lower; }
-    while((availableTime - upper) * upper <= minDistance) { --upper; }
-    assert(lower <= upper);
-    return {lower, upper};
+    uint128 result = 1 % modulus;
+    for (const uint64 count : counts) {
+        result = result * (count % modulus) % modulus;
+    }
+    return static_cast<uint64>(result);
 }
 
-int main() {
-    std::ifstream file("input.txt");
+/*
+ * Every line of the file is a "time distance" race. Prints the number of ways
+ * to win each race and then their product, exact and modulo 10^9 + 7. A line
+ * without exactly two numbers is reported and fails the whole batch.
+ */
+int evaluateBatch(const std::string& path)
+{
+    constexpr uint64 MODULUS = 1'000'000'007;
+    const MappedFile file(path);
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
+    RaceBatch batch;
+    for (const auto line : lines(file.view())) {
+        std::array<uint64, 2> race {0, 0};
+        size_t n = 0;
+        for (const uint64 value : numbers(line)) {
+            if (n < race.size()) {
+                race[n] = value;
+            }
+            ++n;
+        }
+        if (n != race.size()) {
+            std::cerr << "Invalid race: " << line << '\n';
+            return 1;
+        }
+        batch.add(race[0], race[1]);
+    }
+
+    const auto counts = batch.countWaysToWin();
+    for (const uint64 count : counts) {
+        std::cout << count << '\n';
+    }
+    const auto product = checkedProduct(counts);
+    std::cout << "Product: " << (product ? toString(*product) : "overflow") << '\n';
+    std::cout << "Product mod " << MODULUS << ": " << productModulo(counts, MODULUS) << '\n';
+    return 0;
+}
+
+// Numbers of the line after the ':' and all their digits joined for part 2
+std::pair<std::vector<uint128>, uint128> parseRow(std::string_view line)
+{
+    std::vector<uint128> values;
+    uint128 joined = 0;
+    bool inNumber = false;
+    for (const char c : line.substr(line.find(':') + 1)) {
+        if (!std::isdigit(c)) {
+            inNumber = false;
+            continue;
+        }
+        if (!inNumber) {
+            values.push_back(0);
+            inNumber = true;
+        }
+        values.back() = values.back() * 10 + (c - '0');
+        joined = joined * 10 + (c - '0');
+    }
+    return {values, joined};
+}
 
-    std::string line;
-    std::vector<int> times;
-    std::vector<int> distances;
+/*
+ * Usage: main [--batch FILE]
+ * With --batch every line of FILE is evaluated as an independent race.
+ */
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string_view(argv[1]) == "--batch") {
+        return evaluateBatch(argv[2]);
+    }
 
-    std::getline(file, line);
-    auto timesStrs = split(strip(split(line, ":")[1]));
-    std::getline(file, line);
-    auto distStrs = split(strip(split(line, ":")[1]));
-    std::string part2TotalTimeStr {};
-    std::string part2TotalDistStr {};
+    const MappedFile file("input.txt");
+    if (!file) {
+        std::cerr << "Error opening file\n";
+        return 1;
+    }
 
-    int part1 = 1;
-    for (int i = 0; i < timesStrs.size(); ++i) {
-        part2TotalTimeStr += timesStrs[i];
-        part2TotalDistStr += distStrs[i];
-        int time = std::stoi(timesStrs[i]);
-        int dist = std::stoi(distStrs[i]);
-        times.push_back(time);
-        distances.push_back(dist);
-        auto [low, high] = findWaitTimeLimits(time, dist);
-        part1 *= high - low + 1;
+    std::vector<std::string_view> rows;
+    for (const auto line : lines(file.view())) {
+        rows.push_back(line);
     }
-    std::cout << "Part 1: " << part1 << '\n';
+    if (rows.size() < 2) {
+        std::cerr << "Invalid input\n";
+        return 1;
+    }
+    const auto [times, totalTime] = parseRow(rows[0]);
+    const auto [distances, totalDist] = parseRow(rows[1]);
 
-    unsigned long long part2 = 0;
-    unsigned long long totalTime = std::stoull(part2TotalTimeStr);
-    unsigned long long totalDist = std::stoull(part2TotalDistStr);
+    uint128 part1 = 1;
+    for (size_t i = 0; i < times.size(); ++i) {
+        part1 *= countWaysToWin(times[i], distances[i]);
+    }
+    std::cout << "Part 1: " << toString(part1) << '\n';
 
-    auto [low, high] = findWaitTimeLimits(totalTime, totalDist);
-    part2 = high - low + 1;
-    std::cout << "Part 2: " << part2 << '\n';
+    std::cout << "Part 2: " << toString(countWaysToWin(totalTime, totalDist)) << '\n';
     return 0;
 }
@@ -1,10 +1,10 @@
-#include <algorithm>
 #include <cassert>
-#include <fstream>
-#include <string>
+#include <charconv>
+#include <vector>
 #include <array>
+#include <cstdint>
 #include <iostream>
-#include <unordered_map>
+#include <string_view>
 #include "../utils.hpp"
 
 enum HandType
@@ -18,179 +18,126 @@ enum HandType
     FIVE_OF_A_KIND
 };
 
-static const std::unordered_map<char, int> card_values = {
-    {'2', 1},
-    {'3', 2},
-    {'4', 3},
-    {'5', 4},
-    {'6', 5},
-    {'7', 6},
-    {'8', 7},
-    {'9', 8},
-    {'T', 9},
-    {'J', 10},
-    {'Q', 11},
-    {'K', 12},
-    {'A', 13}
-};
-
-static const std::vector<char> cardFromNumber = {
-    '2', '3', '4', '5', '6', '7', '8', '9', 'T',
-    'J', 'Q', 'K', 'A'
-};
+static constexpr std::string_view cardFromNumber = "23456789TJQKA";
 
-class Card
+// Card value (1 to 13) of every character, 0 for characters that are not cards
+static constexpr auto card_values = []
 {
-public:
-    Card(char value, bool part2 = false) : value(value), number(card_values.at(value)) {
-        if (part2 && value == 'J')
-        {
-            number = 0;
-        }
-    }
-
-    bool operator<(const Card& other) const {
-        return number < other.number;
+    std::array<uint8_t, 256> table {};
+    for (size_t i = 0; i < cardFromNumber.size(); ++i) {
+        table[static_cast<unsigned char>(cardFromNumber[i])] = static_cast<uint8_t>(i + 1);
     }
+    return table;
+}();
 
-    bool operator==(const Card& other) const {
-        return number == other.number;
-    }
-
-    bool operator!=(const Card& other) const {
-        return number != other.number;
-    }
+static constexpr uint8_t JOKER_VALUE = card_values['J'];
 
-    char getValue() const { return value; }
-
-    int getNumber() const { return number; }
-
-private:
-    char value;
-    int number;
-};
-
-
-class Hand
+constexpr HandType typeFromGroups(int largest, int second)
 {
-public:
-
-    Hand(const std::string& hand, int f_bid, bool part2 = false) : bid(f_bid) {
-        assert(hand.size() == 5);
-        for (int i = 0; i < 5; ++i) {
-            cards[i] = Card(hand[i], part2);
-        }
-        type = calculateType(part2);
-    }
-
-    bool operator<(const Hand& other) const {
-        if (type != other.type) {
-            return type < other.type;
-        }
-
-        for (int i = 0; i < 5; ++i) {
-            if (cards[i] != other.cards[i]) {
-                return cards[i] < other.cards[i];
-            }
-        }
-        std::cout << "ERROR: Comparing two equal hands" << std::endl;
-        return false;
-    }
-
-    bool operator==(const Hand& other) const {
-        if (type != other.type) {
-            return false;
-        }
-
-        for (int i = 0; i < 5; ++i) {
-            if (cards[i] != other.cards[i]) {
-                return false;
-            }
-        }
-        return true;
-    }
+    if (largest == 5)
+        return HandType::FIVE_OF_A_KIND;
+    if (largest == 4)
+        return HandType::FOUR_OF_A_KIND;
+    if (largest == 3 && second == 2)
+        return HandType::FULL_HOUSE;
+    if (largest == 3)
+        return HandType::THREE_OF_A_KIND;
+    if (largest == 2 && second == 2)
+        return HandType::TWO_PAIR;
+    if (largest == 2)
+        return HandType::ONE_PAIR;
+    return HandType::HIGH_CARD;
+}
 
-    bool operator!=(const Hand& other) const {
-        return !(*this == other);
+/*
+ * The sum of the squared group sizes identifies how up to five cards are
+ * grouped (e.g. 3 + 2 gives 13, 2 + 2 + 1 gives 9). hand_types[jokers][sum]
+ * is the best type reachable when the jokers join the largest group of the
+ * other 5 - jokers cards.
+ */
+static constexpr auto hand_types = []
+{
+    std::array<std::array<HandType, 26>, 6> table {};
+    for (int a = 0; a <= 5; ++a)
+        for (int b = 0; b <= a; ++b)
+            for (int c = 0; c <= b; ++c)
+                for (int d = 0; d <= c; ++d)
+                    for (int e = 0; e <= d && a + b + c + d + e <= 5; ++e) {
+                        const int cards = a + b + c + d + e;
+                        const int signature = a * a + b * b + c * c + d * d + e * e;
+                        table[5 - cards][signature] = typeFromGroups(a + 5 - cards, b);
+                    }
+    return table;
+}();
+
+// Type in bits 20-23 and one card per 4 bits below, so keys sort like hands
+constexpr unsigned SORT_KEY_BITS = 24;
+
+/*
+ * Sort keys of a hand under both rule sets from a single pass over its cards.
+ * Removing the jokers' group from the part 1 histogram leaves the part 2 one,
+ * so the part 2 signature is the part 1 signature minus jokers².
+ */
+std::array<uint32, 2> dualSortKeys(std::string_view hand)
+{
+    assert(hand.size() == 5);
+    std::array<uint8_t, 14> counts {};
+    int signature = 0;
+    uint32 part1 = 0;
+    uint32 part2 = 0;
+    for (const char c : hand) {
+        const uint8_t number = card_values[static_cast<unsigned char>(c)];
+        assert(number != 0);
+        signature += 2 * counts[number]++ + 1;
+        part1 = part1 << 4 | number;
+        part2 = part2 << 4 | (number == JOKER_VALUE ? 0 : number);
     }
+    const int jokers = counts[JOKER_VALUE];
+    part1 |= static_cast<uint32>(hand_types[0][signature]) << 20;
+    part2 |= static_cast<uint32>(hand_types[jokers][signature - jokers * jokers]) << 20;
+    return {part1, part2};
+}
 
-    int getBid() const { return bid; }
-
-    HandType getType() const { return type; }
-
-private:
-    std::array<Card, 5> cards {{'2', '2', '2', '2', '2'}};
-    HandType type;
-    int bid;
-
-    HandType calculateType(bool part2) const {
-        std::unordered_map<char, int> card_counts;
-        for (const auto& card : cards) {
-            ++card_counts[card.getValue()];
-        }
-        int numberOfJs = 0;
-        if (part2 && card_counts.contains('J'))
-        {
-            if (card_counts.size() == 1)
-            {
-                return HandType::FIVE_OF_A_KIND;
-            }
-            numberOfJs = card_counts['J'];
-            card_counts.erase('J');
-        }
-        std::vector<int> counts {};
-        for (const auto& [_, count] : card_counts) {
-            counts.push_back(count);
-        }
-        std::sort(counts.rbegin(), counts.rend());
-        counts[0] += numberOfJs;
-
-        if (counts[0] == 5)
-            return HandType::FIVE_OF_A_KIND;
-        if (counts[0] == 4)
-            return HandType::FOUR_OF_A_KIND;
-        if (counts[0] == 3 && counts[1] == 2)
-            return HandType::FULL_HOUSE;
-        if (counts[0] == 3)
-            return HandType::THREE_OF_A_KIND;
-        if (counts[0] == 2 && counts[1] == 2)
-            return HandType::TWO_PAIR;
-        if (counts[0] == 2)
-            return HandType::ONE_PAIR;
-        return HandType::HIGH_CARD;
+/*
+ * Ranks the hands with a radix sort on their packed keys. Each entry holds the
+ * key in the high half and the bid in the low half, so the bid travels with
+ * its hand.
+ */
+uint64 totalWinnings(std::vector<uint64>& entries)
+{
+    radixSort(entries, 32, 32 + SORT_KEY_BITS);
+    uint64 result = 0;
+    for (uint64 rank = 1; const uint64 entry : entries) {
+        result += (entry & 0xffffffff) * rank++;
     }
-};
-
+    return result;
+}
 
 int main() {
-    std::ifstream file("input.txt");
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
-    std::vector<Hand> handsPart1;
-    std::vector<Hand> handsPart2;
-    std::string line;
-    while (std::getline(file, line)) {
-        auto splLine = split(line);
-        Hand handPart1 {splLine[0], std::stoi(splLine[1]), false};
-        Hand handPart2 {splLine[0], std::stoi(splLine[1]), true};
-        auto it = std::upper_bound(handsPart1.begin(), handsPart1.end(), handPart1);
-        handsPart1.insert(it, handPart1);
-        auto it2 = std::upper_bound(handsPart2.begin(), handsPart2.end(), handPart2);
-        handsPart2.insert(it2, handPart2);
-    }
-    int n = handsPart1.size();
-    unsigned long part1 = 0;
-    unsigned long part2 = 0;
-    for (int i = 0; i < n; ++i) {
-        part1 += handsPart1[i].getBid() * (i + 1);
-        part2 += handsPart2[i].getBid() * (i + 1);
+    // Each line is parsed and classified once; the two rankings then sort in parallel
+    std::array<std::vector<uint64>, 2> hands;
+    for (const auto line : lines(file.view())) {
+        const size_t space = line.find(' ');
+        assert(space != std::string_view::npos);
+        uint32 bid = 0;
+        std::from_chars(line.data() + space + 1, line.data() + line.size(), bid);
+        const auto keys = dualSortKeys(line.substr(0, space));
+        for (size_t part = 0; part < 2; ++part) {
+            hands[part].push_back(static_cast<uint64>(keys[part]) << 32 | bid);
+        }
     }
 
-    std::cout << "Part 1: " << part1 << '\n';
-    std::cout << "Part 2: " << part2 << '\n';
+    std::array<uint64, 2> winnings {};
+    parallel_for(2, [&](size_t part) { winnings[part] = totalWinnings(hands[part]); }, 2);
+
+    std::cout << "Part 1: " << winnings[0] << '\n';
+    std::cout << "Part 2: " << winnings[1] << '\n';
 
     return 0;
 }
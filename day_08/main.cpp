@@ -1,177 +1,455 @@
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
 #include <cassert>
+#include <cstdint>
 #include <concepts>
 #include <fstream>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <ranges>
 #include <iostream>
-#include <unordered_map>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <string_view>
+#include <vector>
 #include "../utils.hpp"
 
 using ulong = unsigned long long int;
 
 
-class GameNode
+// Three-letter codes map densely onto 0..26³, so a node id fits in 15 bits
+constexpr size_t NODE_COUNT = 26 * 26 * 26;
+using NodeId = uint16_t;
+
+constexpr bool isNodeCode(std::string_view code)
+{
+    return code.size() == 3 && std::ranges::all_of(code, [](char c) { return c >= 'A' && c <= 'Z'; });
+}
+
+constexpr NodeId nodeId(std::string_view code)
+{
+    assert(code.size() == 3);
+    return static_cast<NodeId>(((code[0] - 'A') * 26 + (code[1] - 'A')) * 26 + (code[2] - 'A'));
+}
+
+std::string nodeCode(NodeId id)
+{
+    return {static_cast<char>('A' + id / 676), static_cast<char>('A' + id / 26 % 26), static_cast<char>('A' + id % 26)};
+}
+
+constexpr char lastLetter(NodeId id) { return static_cast<char>('A' + id % 26); }
+
+
+/*
+ * The network as flat successor arrays indexed by node id: a step is a single
+ * array load, with no hashing or string copies.
+ */
+class Network
 {
 public:
 
-    GameNode() = default;
+    // Reads "AAA = (BBB, CCC)" lines until the end of the stream. Codes must be
+    // three letters A-Z; anything else throws std::runtime_error.
+    explicit Network(std::istream& file) {
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty())
+                continue;
+            const std::string_view text = line;
+            if (text.size() != 16 || text.substr(3, 4) != " = (" || text.substr(10, 2) != ", " || text[15] != ')' ||
+                !isNodeCode(text.substr(0, 3)) || !isNodeCode(text.substr(7, 3)) || !isNodeCode(text.substr(12, 3)))
+            {
+                throw std::runtime_error("Invalid node line: " + line);
+            }
+            const NodeId node = nodeId(text.substr(0, 3));
+            left[node] = nodeId(text.substr(7, 3));
+            right[node] = nodeId(text.substr(12, 3));
+            defined[node] = true;
+            endsWithZ[node] = lastLetter(node) == 'Z';
+            nodes.push_back(node);
+        }
+        validateConnections();
+    }
+
+    NodeId getConnected(NodeId node, char direction) const {
+        assert(direction == 'L' || direction == 'R');
+        return direction == 'L' ? left[node] : right[node];
+    }
+
+    bool isEnd(NodeId node) const { return endsWithZ[node]; }
 
-    GameNode(const std::string& code)
-        : code(code) {}
+    bool contains(NodeId node) const { return defined[node]; }
 
-    std::string getCode() const { return code; }
+    // Defined nodes in input order
+    const std::vector<NodeId>& getNodes() const { return nodes; }
 
-    bool operator==(const GameNode& other) const {
-        return code == other.code;
+private:
+    std::array<NodeId, NODE_COUNT> left {};
+    std::array<NodeId, NODE_COUNT> right {};
+    std::bitset<NODE_COUNT> endsWithZ;
+    std::bitset<NODE_COUNT> defined;
+    std::vector<NodeId> nodes;
+
+    void validateConnections() const {
+        for (const NodeId node : nodes) {
+            if (!defined[left[node]] || !defined[right[node]])
+            {
+                std::cout << "Node " << nodeCode(node) << " has an undefined connection\n";
+                assert(false);
+            }
+        }
     }
+};
 
-    GameNode* getLeft() const { return left; }
-    GameNode* getRight() const { return right; }
 
-    GameNode* getConnected(char direction) const {
-        if (direction == 'L')
-            return left;
-        else if (direction == 'R')
-            return right;
-        else
-        {
-            std::cerr << "Invalid direction: " << direction << '\n';
-            assert(false);
-            return nullptr;
+struct EndHit
+{
+    ulong steps;
+    NodeId node;
+};
+
+
+/*
+ * Binary-lifting tables over whole passes of the instructions. Level k maps a
+ * node at the start of a pass to the node 2^k passes later and flags whether a
+ * Z-node is hit on the way; the Z-hits of a single pass are kept per node.
+ * Walks then cost O(log passes) table hops plus at most one partial pass.
+ */
+class PassTables
+{
+public:
+
+    PassTables(const Network& network, std::string_view instructions)
+        : network(network), instructions(instructions), hitBegin(NODE_COUNT + 1, 0) {
+        assert(!instructions.empty());
+        const ulong passLength = instructions.size();
+        // Enough levels to cover the passes of any 64-bit step count; with a
+        // single instruction that is all 64 of them
+        levels = std::bit_width(~0ULL / passLength);
+        next.resize(levels);
+        anyEnd.resize(levels);
+
+        for (size_t node = 0; node < NODE_COUNT; ++node) {
+            hitBegin[node] = hits.size();
+            if (!network.contains(node))
+                continue;
+            NodeId current = node;
+            for (size_t i = 0; i < instructions.size(); ++i) {
+                if (network.isEnd(current))
+                    hits.push_back({static_cast<uint32>(i), current});
+                current = network.getConnected(current, instructions[i]);
+            }
+            next[0][node] = current;
+            anyEnd[0][node] = hits.size() != hitBegin[node];
+        }
+        hitBegin[NODE_COUNT] = hits.size();
+
+        for (unsigned k = 1; k < levels; ++k) {
+            for (const NodeId node : network.getNodes()) {
+                const NodeId middle = next[k - 1][node];
+                next[k][node] = next[k - 1][middle];
+                anyEnd[k][node] = anyEnd[k - 1][node] || anyEnd[k - 1][middle];
+            }
         }
     }
 
-    void setConnections(GameNode* left, GameNode* right) {
-        this->left = left;
-        this->right = right;
+    ulong getPassLength() const { return instructions.size(); }
+
+    NodeId nextPass(NodeId node) const { return next[0][node]; }
+
+    // Calls f(offset, node) for every Z-node hit during one pass started at node
+    template<typename F>
+    void forEachPassHit(NodeId node, F f) const {
+        for (uint32 h = hitBegin[node]; h < hitBegin[node + 1]; ++h) {
+            f(hits[h].offset, hits[h].node);
+        }
     }
 
-    void validateConnections() const {
-        if (left == nullptr || right == nullptr)
-        {
-            std::cout << "Node " << code << " has a null connection\n";
-            assert(false);
+    NodeId advancePasses(NodeId node, ulong passes) const {
+        assert(levels == 64 || passes >> levels == 0);
+        for (unsigned k = 0; passes != 0; ++k, passes >>= 1) {
+            if (passes & 1)
+                node = next[k][node];
+        }
+        return node;
+    }
+
+    // Node reached from node after the given number of steps
+    NodeId advance(NodeId node, ulong steps) const {
+        node = advancePasses(node, steps / getPassLength());
+        for (size_t i = 0; i < steps % getPassLength(); ++i) {
+            node = network.getConnected(node, instructions[i]);
         }
+        return node;
+    }
+
+    // First Z-node at or after minSteps on the walk from node, if any is ever reached
+    std::optional<EndHit> nextEnd(NodeId node, ulong minSteps = 0) const {
+        ulong passes = minSteps / getPassLength();
+        const ulong offset = minSteps % getPassLength();
+        node = advancePasses(node, passes);
+        for (uint32 h = hitBegin[node]; h < hitBegin[node + 1]; ++h) {
+            if (hits[h].offset >= offset)
+                return EndHit {passes * getPassLength() + hits[h].offset, hits[h].node};
+        }
+        node = next[0][node];
+        ++passes;
+
+        // Skip the largest runs of passes that hit no Z-node
+        for (unsigned k = levels; k-- > 0;) {
+            if (!anyEnd[k][node])
+            {
+                node = next[k][node];
+                passes += 1ULL << k;
+            }
+        }
+        // The walk is periodic within NODE_COUNT passes, so this means never
+        if (!anyEnd[0][node])
+            return std::nullopt;
+        const auto& hit = hits[hitBegin[node]];
+        return EndHit {passes * getPassLength() + hit.offset, hit.node};
     }
 
 private:
-    std::string code;
-    GameNode* left {nullptr};
-    GameNode* right {nullptr};
+    struct PassHit
+    {
+        uint32 offset;
+        NodeId node;
+    };
+
+    const Network& network;
+    std::string instructions;
+    unsigned levels;
+    std::vector<std::array<NodeId, NODE_COUNT>> next;
+    std::vector<std::bitset<NODE_COUNT>> anyEnd;
+    // Z-hits of one pass from node are hits[hitBegin[node]..hitBegin[node + 1])
+    std::vector<uint32> hitBegin;
+    std::vector<PassHit> hits;
 };
 
 
 struct CycleNode
 {
-    std::string code;
+    NodeId node;
     int instructionIndex;
     ulong steps;
 
     bool operator==(const CycleNode& other) const {
-        return code == other.code && instructionIndex == other.instructionIndex;
+        return node == other.node && instructionIndex == other.instructionIndex;
     }
 };
 
-std::vector<CycleNode> findCycles(const GameNode* startNode, const std::unordered_map<std::string, GameNode>& nodes, const std::string& instructions)
+/*
+ * The walk of one ghost: Z-hits before it enters its cycle, then Z-hits of one
+ * turn of the cycle, which repeat every length steps from then on. A pass
+ * always starts at instruction 0, so the node at the start of a pass is the
+ * (node, instruction index) state that closes the cycle.
+ */
+struct GhostCycle
 {
-    std::vector<CycleNode> foundCycleNodes;
-    ulong steps = 0;
-    const int nInstructions = instructions.size();
-    int i = 0;
-    std::string currentNode = startNode->getCode();
-    while (true)
+    ulong tail;
+    ulong length;
+    std::vector<CycleNode> tailHits;
+    std::vector<CycleNode> cycleHits;
+
+    bool isEnd(ulong steps) const {
+        const auto& hits = steps < tail ? tailHits : cycleHits;
+        if (steps >= tail)
+            steps = tail + (steps - tail) % length;
+        const auto it = std::ranges::lower_bound(hits, steps, {}, &CycleNode::steps);
+        return it != hits.end() && it->steps == steps;
+    }
+};
+
+GhostCycle findGhostCycle(NodeId startNode, const PassTables& tables)
+{
+    std::vector<int32> firstPass(NODE_COUNT, -1);
+    std::vector<NodeId> passStarts;
+    NodeId node = startNode;
+    while (firstPass[node] < 0)
     {
-        if (currentNode[2] == 'Z')
-        {
-            CycleNode cycleNode {currentNode, i, steps};
-            bool visited = std::find(foundCycleNodes.begin(), foundCycleNodes.end(), cycleNode) != foundCycleNodes.end();
-            foundCycleNodes.push_back(cycleNode);
-            if (visited)
-            {
-                return foundCycleNodes;
+        firstPass[node] = passStarts.size();
+        passStarts.push_back(node);
+        node = tables.nextPass(node);
+    }
+
+    const ulong passLength = tables.getPassLength();
+    GhostCycle cycle {firstPass[node] * passLength, (passStarts.size() - firstPass[node]) * passLength, {}, {}};
+    for (size_t pass = 0; pass < passStarts.size(); ++pass) {
+        tables.forEachPassHit(passStarts[pass], [&](uint32 offset, NodeId hitNode) {
+            CycleNode hit {hitNode, static_cast<int>(offset), pass * passLength + offset};
+            (hit.steps < cycle.tail ? cycle.tailHits : cycle.cycleHits).push_back(hit);
+        });
+    }
+    return cycle;
+}
+
+
+// x ≡ residue (mod modulus)
+struct Congruence
+{
+    uint128 residue;
+    uint128 modulus;
+};
+
+// Modular inverse of a modulo m for coprime a and m
+ulong inverseModulo(ulong a, ulong m)
+{
+    int128 oldR = a, r = m;
+    int128 oldS = 1, s = 0;
+    while (r != 0)
+    {
+        const int128 q = oldR / r;
+        oldR = std::exchange(r, oldR - q * r);
+        oldS = std::exchange(s, oldS - q * s);
+    }
+    assert(oldR == 1);
+    return static_cast<ulong>(oldS < 0 ? oldS + m : oldS) % m;
+}
+
+/*
+ * Generalized CRT for a combined congruence and the congruence of a single
+ * ghost, whose modulus fits in 64 bits. No solution when the residues disagree
+ * modulo the gcd of the moduli; throws if the lcm does not fit in 128 bits.
+ */
+std::optional<Congruence> combine(const Congruence& a, ulong residue, ulong modulus)
+{
+    const ulong g = std::gcd(static_cast<ulong>(a.modulus % modulus), modulus);
+    const ulong aResidue = a.residue % modulus;
+    const ulong difference = residue >= aResidue ? residue - aResidue : residue + modulus - aResidue;
+    if (difference % g != 0)
+        return std::nullopt;
+
+    const ulong n = modulus / g;
+    const ulong step = static_cast<ulong>(a.modulus / g % n);
+    const ulong k = static_cast<ulong>(static_cast<uint128>(difference / g) * inverseModulo(step, n) % n);
+    uint128 lcm;
+    if (__builtin_mul_overflow(a.modulus, static_cast<uint128>(n), &lcm))
+        throw std::overflow_error("Combined cycle length does not fit in 128 bits");
+    return Congruence {a.residue + a.modulus * k, lcm};
+}
+
+/*
+ * First step at which every ghost stands on a Z-node, if there is one. Steps
+ * before the longest tail must be tail hits of that ghost and are checked
+ * directly; later steps are the CRT solutions over all combinations of cycle
+ * hits, lifted above the longest tail.
+ */
+std::optional<uint128> firstCommonEnd(const std::vector<GhostCycle>& ghosts)
+{
+    if (ghosts.empty())
+        return 0;
+    const auto& longestTail = *std::ranges::max_element(ghosts, {}, &GhostCycle::tail);
+    for (const auto& hit : longestTail.tailHits) {
+        if (std::ranges::all_of(ghosts, [&](const GhostCycle& ghost) { return ghost.isEnd(hit.steps); }))
+            return hit.steps;
+    }
+
+    std::vector<Congruence> solutions {{0, 1}};
+    for (const auto& ghost : ghosts) {
+        std::vector<Congruence> combined;
+        for (const auto& solution : solutions) {
+            for (const auto& hit : ghost.cycleHits) {
+                if (const auto c = combine(solution, hit.steps % ghost.length, ghost.length))
+                    combined.push_back(*c);
             }
         }
-        char direction = instructions[i];
-        currentNode = nodes.at(currentNode).getConnected(direction)->getCode();
-        steps++;
-        i++;
-        if (i >= nInstructions)
-            i = 0;
+        // All solutions share the same modulus, so equal residues are duplicates
+        std::ranges::sort(combined, {}, &Congruence::residue);
+        const auto duplicates = std::ranges::unique(combined, {}, &Congruence::residue);
+        combined.erase(duplicates.begin(), duplicates.end());
+        solutions = std::move(combined);
     }
-}
 
-ulong lcm(ulong a, ulong b) { return (a / std::gcd(a, b)) * b; }
+    std::optional<uint128> result;
+    for (const auto& [residue, modulus] : solutions) {
+        uint128 steps = residue;
+        if (steps < longestTail.tail)
+            steps += (longestTail.tail - steps + modulus - 1) / modulus * modulus;
+        if (!result || steps < *result)
+            result = steps;
+    }
+    return result;
+}
 
 
-int main() {
+/*
+ * Usage: main [--at CODE STEPS]
+ * With --at the node reached from CODE after STEPS steps is printed.
+ */
+int main(int argc, char* argv[]) {
     std::ifstream file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
-    std::unordered_map<std::string, GameNode> nodes;
-
-    std::string line;
-    std::getline(file, line);
-    std::string instructions = line;
-    std::getline(file, line);
-    while (std::getline(file, line)) {
-        auto lineSpl = split(line, " = ");
-        std::string code = lineSpl[0];
-        GameNode node {code};
-        nodes[code] = node;
-        std::string leftRight = lineSpl[1];
-        leftRight.replace(0, 1, "");
-        leftRight.replace(leftRight.size() - 1, 1, "");
-        auto leftRightSpl = split(leftRight, ", ");
-        std::string leftCode = leftRightSpl[0];
-        std::string rightCode = leftRightSpl[1];
-        if (!nodes.contains(leftCode))
-            nodes[leftCode] = GameNode {leftCode};
-        if (!nodes.contains(rightCode))
-            nodes[rightCode] = GameNode {rightCode};
-        nodes[code].setConnections(&(nodes[leftCode]), &(nodes[rightCode]));
-    }
-
-    // Validate
-    for (const auto& [_, node] : nodes) {
-        node.validateConnections();
-    }
-
-    unsigned long long int steps = 0;
-    int nInstructions = instructions.size();
-    int i = 0;
-    std::string currentNode = "AAA";
-
-    while (true)
+    std::string instructions;
+    std::getline(file, instructions);
+    std::optional<Network> parsedNetwork;
+    try {
+        parsedNetwork.emplace(file);
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+    const Network& network = *parsedNetwork;
+    const PassTables tables {network, instructions};
+
+    if (argc > 3 && std::string_view(argv[1]) == "--at") {
+        if (!isNodeCode(argv[2]) || !network.contains(nodeId(argv[2]))) {
+            std::cerr << "Unknown node: " << argv[2] << '\n';
+            return 1;
+        }
+        std::cout << nodeCode(tables.advance(nodeId(argv[2]), std::stoull(argv[3]))) << '\n';
+        return 0;
+    }
+
+    // Part 1: follow the Z-hits from AAA until one of them is ZZZ. The walk
+    // repeats once a pass starts on a node it already started on, so every
+    // reachable state is visited within one pass per defined node.
+    const NodeId targetNode = nodeId("ZZZ");
+    const ulong walkLimit = network.getNodes().size() * tables.getPassLength();
+    std::optional<EndHit> hit;
+    for (ulong minSteps = 0; network.contains(nodeId("AAA")); minSteps = hit->steps + 1)
     {
-        if (currentNode == "ZZZ")
+        hit = tables.nextEnd(nodeId("AAA"), minSteps);
+        if (!hit || hit->node == targetNode || hit->steps >= walkLimit)
             break;
-        char direction = instructions[i];
-        currentNode = nodes[currentNode].getConnected(direction)->getCode();
-        steps++;
-        i++;
-        if (i >= nInstructions)
-            i = 0;
-    }
-    std::cout << "Part 1: " << steps << '\n';
-
-    // Part 2
-    steps = 0;
-    i = 0;
-    ulong minimumSteps = 1;
-    for (const auto& [_, node] : nodes) {
-        if (node.getCode()[2] == 'A')
-        {
-            auto cycle = findCycles(&node, nodes, instructions);
-            assert(cycle[1].steps == cycle[0].steps*2);
-            minimumSteps = lcm(minimumSteps, cycle[0].steps);
-        }
+    }
+    // A network without a reachable ZZZ still gets its part 2 answer
+    int exitCode = 0;
+    if (!hit || hit->node != targetNode) {
+        std::cerr << "ZZZ is never reached\n";
+        exitCode = 1;
+    }
+    else {
+        std::cout << "Part 1: " << hit->steps << '\n';
     }
 
-    std::cout << "Part 2: " << minimumSteps << '\n';
-    return 0;
+    // Part 2: the cycle of every ..A start is searched in parallel
+    std::vector<NodeId> starts;
+    std::ranges::copy_if(network.getNodes(), std::back_inserter(starts), [](NodeId node) { return lastLetter(node) == 'A'; });
+    std::vector<GhostCycle> ghosts(starts.size());
+    parallel_for(starts.size(), [&](size_t i) { ghosts[i] = findGhostCycle(starts[i], tables); });
+
+    std::optional<uint128> minimumSteps;
+    try {
+        minimumSteps = firstCommonEnd(ghosts);
+    }
+    catch (const std::overflow_error& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+    if (!minimumSteps) {
+        std::cerr << "The ghosts never all stand on Z-nodes\n";
+        return 1;
+    }
+    std::cout << "Part 2: " << toString(*minimumSteps) << '\n';
+    return exitCode;
 }
@@ -1,67 +1,223 @@
 #include <algorithm>
-#include <fstream>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <vector>
 #include "../utils.hpp"
 
 
+int128 checkedAdd(int128 a, int128 b)
+{
+    int128 result;
+    if (__builtin_add_overflow(a, b, &result))
+        throw std::overflow_error("Extrapolation does not fit in 128 bits");
+    return result;
+}
+
+int128 checkedMultiply(int128 a, int128 b)
+{
+    int128 result;
+    if (__builtin_mul_overflow(a, b, &result))
+        throw std::overflow_error("Extrapolation does not fit in 128 bits");
+    return result;
+}
+
+
 struct SolutionLine
 {
-    int part1;
-    int part2;
+    int128 part1;
+    int128 part2;
 
     SolutionLine& operator+=(const SolutionLine& other) {
-        part1 += other.part1;
-        part2 += other.part2;
+        part1 = checkedAdd(part1, other.part1);
+        part2 = checkedAdd(part2, other.part2);
         return *this;
     }
 };
 
 
-int calcPart2(const std::vector<int>& firstValues) {
-    int result = 0;
-    for (const auto& val : firstValues | std::views::reverse)
-    {
-        result = val - result;
+int128 binomial(int128 n, int128 k)
+{
+    int128 result = 1;
+    for (int128 i = 1; i <= k; ++i) {
+        // result is C(n - k + i - 1, i - 1), so the division is exact
+        result = checkedMultiply(result, n - k + i) / i;
     }
     return result;
 }
 
-SolutionLine evalLine(std::vector<int>& vals) {
-    SolutionLine result {};
-    std::vector<int> leftVals;
-    while (vals.size() > 0 && !std::all_of(vals.begin(), vals.end(), [](int x) { return x == 0; })) {
-        result.part1 += vals.back();
-        leftVals.push_back(vals.front());
-        for (int i{}; auto [left, right] : vals | std::views::adjacent<2>) {
-            vals[i++] = right - left;
+/*
+ * Repeating the difference rows until they are all zero extends a sequence of
+ * length n as the polynomial of degree < n through it. Its value at any
+ * position is then a fixed signed binomial combination of the inputs:
+ *   position t >= n:  w[i] = (-1)^(n-1-i) C(t, i) C(t-i-1, n-1-i)
+ *   position -k < 0:  w[i] = (-1)^i C(k+i-1, i) C(k+n-1, n-1-i)
+ * Position n is the next value and -1 the previous one.
+ */
+std::vector<int128> extrapolationWeights(size_t length, int64 position)
+{
+    std::vector<int128> weights(length, 0);
+    const int128 n = length;
+    if (position >= 0 && position < n) {
+        weights[position] = 1;
+        return weights;
+    }
+    for (int128 i = 0; i < n; ++i) {
+        int128 weight;
+        if (position >= n) {
+            const int128 t = position;
+            weight = checkedMultiply(binomial(t, i), binomial(t - i - 1, n - 1 - i));
+            weights[i] = (n - 1 - i) % 2 == 0 ? weight : -weight;
+        } else {
+            const int128 k = -static_cast<int128>(position);
+            weight = checkedMultiply(binomial(k + i - 1, i), binomial(k + n - 1, n - 1 - i));
+            weights[i] = i % 2 == 0 ? weight : -weight;
         }
-        vals.pop_back();
     }
-    result.part2 = calcPart2(leftVals);
-    return result;
+    return weights;
 }
 
 
-int main() {
-    std::ifstream file("input.txt");
+/*
+ * Lines of one length, stored column by column (columns[i][line]), so that
+ * extrapolating is one dot product per line with the same weight applied to
+ * consecutive lines, which fill the SIMD lanes.
+ */
+class LineBatch
+{
+public:
+
+    explicit LineBatch(size_t length) : columns(length) {}
+
+    void add(const std::vector<int64>& line) {
+        assert(line.size() == columns.size());
+        for (size_t i = 0; i < line.size(); ++i) {
+            columns[i].push_back(line[i]);
+            maxAbsValue = std::max<uint64>(maxAbsValue, line[i] < 0 ? -static_cast<uint64>(line[i]) : line[i]);
+        }
+        ++count;
+    }
+
+    size_t size() const { return count; }
+
+    // Value of every line at the position the weights were built for
+    std::vector<int128> extrapolate(const std::vector<int128>& weights) const {
+        assert(weights.size() == columns.size());
+        std::vector<int128> result(count, 0);
+        if (fitsInt64(weights)) {
+            extrapolate64(weights, result);
+            return result;
+        }
+        for (size_t i = 0; i < columns.size(); ++i) {
+            for (size_t line = 0; line < count; ++line) {
+                result[line] = checkedAdd(result[line], checkedMultiply(weights[i], columns[i][line]));
+            }
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::vector<int64>> columns;
+    size_t count {0};
+    uint64 maxAbsValue {0};
+
+    static constexpr int64 INT32_LIMIT = 0x7fffffff;
+
+    // Both factors fit in 32 bits and no dot product can leave 64 bits
+    bool fitsInt64(const std::vector<int128>& weights) const {
+        if (maxAbsValue > INT32_LIMIT)
+            return false;
+        uint128 bound = 0;
+        for (const int128 weight : weights) {
+            if (weight > INT32_LIMIT || weight < -INT32_LIMIT)
+                return false;
+            bound += static_cast<uint128>(weight < 0 ? -weight : weight) * maxAbsValue;
+        }
+        return bound <= static_cast<uint128>(INT64_MAX);
+    }
+
+    void extrapolate64(const std::vector<int128>& weights, std::vector<int128>& result) const {
+        size_t line = 0;
+#if defined(__AVX2__)
+        // _mm256_mul_epi32 multiplies the signed low halves of the 64-bit lanes
+        for (; line + 4 <= count; line += 4) {
+            __m256i sum = _mm256_setzero_si256();
+            for (size_t i = 0; i < columns.size(); ++i) {
+                const __m256i values =
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns[i].data() + line));
+                const __m256i weight = _mm256_set1_epi64x(static_cast<int64>(weights[i]));
+                sum = _mm256_add_epi64(sum, _mm256_mul_epi32(values, weight));
+            }
+            alignas(32) std::array<int64, 4> lanes;
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes.data()), sum);
+            for (size_t lane = 0; lane < 4; ++lane) {
+                result[line + lane] = lanes[lane];
+            }
+        }
+#endif
+        for (; line < count; ++line) {
+            int64 sum = 0;
+            for (size_t i = 0; i < columns.size(); ++i) {
+                sum += static_cast<int64>(weights[i]) * columns[i][line];
+            }
+            result[line] = sum;
+        }
+    }
+};
+
+
+/*
+ * Usage: main [--steps K]
+ * With --steps the sequences are extrapolated K steps ahead and K steps behind
+ * instead of one.
+ */
+int main(int argc, char* argv[]) {
+    int64 steps = 1;
+    if (argc > 2 && std::string_view(argv[1]) == "--steps") {
+        steps = std::stoll(argv[2]);
+        if (steps < 1) {
+            std::cerr << "The number of steps must be positive\n";
+            return 1;
+        }
+    }
+
+    const MappedFile file("input.txt");
     if (!file) {
         std::cerr << "Error opening file\n";
         return 1;
     }
 
+    std::map<size_t, LineBatch> batches;
+    std::vector<int64> vals;
+    for (const auto line : lines(file.view())) {
+        vals.clear();
+        for (const int64 val : numbers<int64>(line)) {
+            vals.push_back(val);
+        }
+        batches.try_emplace(vals.size(), vals.size()).first->second.add(vals);
+    }
+
     SolutionLine result {};
-    std::string line;
-    while (std::getline(file, line)) {
-        auto valsStr = split(line);
-        std::vector<int> vals;
-        for (auto& valStr : valsStr) {
-            vals.push_back(std::stoi(valStr));
+    try {
+        for (const auto& [length, batch] : batches) {
+            const auto ahead = batch.extrapolate(extrapolationWeights(length, length - 1 + steps));
+            const auto behind = batch.extrapolate(extrapolationWeights(length, -steps));
+            for (size_t line = 0; line < batch.size(); ++line) {
+                result += SolutionLine {ahead[line], behind[line]};
+            }
         }
-        result += evalLine(vals);
+    }
+    catch (const std::overflow_error& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
     }
 
-    std::cout << "Part 1: " << result.part1 << "\n";
-    std::cout << "Part 2: " << result.part2 << "\n";
+    std::cout << "Part 1: " << toString(result.part1) << "\n";
+    std::cout << "Part 2: " << toString(result.part2) << "\n";
     return 0;
 }
@@ -80,16 +80,13 @@ int main() {
     PipesArray pipes {};
     Coord start_coord { 0, 0 };
     while (std::getline(file, line)) {
-        std::vector<char> vec;
-        for (auto c : line) {
-            if (c == 'S')
-            {
-                c = '7'; // Inspecting the file
-                start_coord = { pipes.matrix.size(), vec.size() };
-            }
-            vec.push_back(c);
+        std::vector<char> vec(line.begin(), line.end());
+        if (const auto col = findFirstOf(line, "S"); col != std::string::npos)
+        {
+            vec[col] = '7'; // Inspecting the file
+            start_coord = { pipes.matrix.size(), col };
         }
-        pipes.matrix.push_back(vec);
+        pipes.matrix.push_back(std::move(vec));
     }
 
     int pipe_length = 0;
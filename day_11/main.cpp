@@ -83,12 +83,9 @@ int main() {
     size_t row = 0;
     std::vector<Coord> galaxies;
     while (std::getline(file, line)) {
-        for (size_t col{}; auto c: line) {
-            if (c == '#') {
-                galaxies.push_back({row, col});
-            }
-            ++col;
-        }
+        forEachMatch(line, '#', [&galaxies, row](size_t col) {
+            galaxies.push_back({row, col});
+        });
         ++row;
     }
     std::vector<size_t> occupiedRows;
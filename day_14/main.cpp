@@ -11,19 +11,18 @@ public:
     static constexpr uint32 nCols = 100;
 
     void addRow(const std::string& row) {
-        for (uint32 i = 0; i < row.size(); ++i) {
-            uint32 value;
-            if (row[i] == '.') {
-                value = 0;
-            } else if (row[i] == '#') {
-                value = 1;
-            } else if (row[i] == 'O') {
-                value = 2;
-            } else {
+        for (uint32 offset = 0; offset < row.size(); offset += SIMD_BLOCK) {
+            const char* block = row.data() + offset;
+            const size_t size = std::min(SIMD_BLOCK, row.size() - offset);
+            const uint32 walls = eqMask(block, '#', size);
+            const uint32 rocks = eqMask(block, 'O', size);
+            if ((walls | rocks | eqMask(block, '.', size)) != blockBits(size)) {
                 std::cerr << "Error: invalid character in maze\n";
                 return;
             }
-            maze[currentRow][i] = value;
+            for (uint32 i = 0; i < size; ++i) {
+                maze[currentRow][offset + i] = (walls >> i & 1) | (rocks >> i & 1) << 1;
+            }
         }
         ++currentRow;
     }
@@ -65,9 +65,7 @@ public:
     // static constexpr uint32 N_COLS = 10;
 
     void addRow(const std::string& row) {
-        for (uint32 col_idx = 0; col_idx < N_COLS; ++col_idx) {
-            maze[row_idx][col_idx] = row[col_idx];
-        }
+        std::copy_n(row.data(), N_COLS, maze[row_idx].begin());
         ++row_idx;
     }
 
@@ -6,6 +6,7 @@
 #include <mdspan>
 #include <ranges>
 #include <string>
+#include "../utils.hpp"
 
 enum class ETile
 {
@@ -17,7 +18,7 @@ enum class ETile
     slopeLeft
 };
 
-ETile charToTile(const char c)
+constexpr ETile charToTile(const char c)
 {
     switch (c)
     {
@@ -38,6 +39,33 @@ ETile charToTile(const char c)
     }
 }
 
+constexpr std::string_view TILE_CHARS = ".#^v<>";
+
+constexpr auto TILE_FROM_CHAR = []
+{
+    std::array<ETile, 256> table {};
+    for (const char c : TILE_CHARS)
+        table[static_cast<unsigned char>(c)] = charToTile(c);
+    return table;
+}();
+
+/*
+ * Validates each block of the row at once and then translates it through the
+ * lookup table.
+ */
+void appendRow(std::string_view line, std::vector<ETile>& data)
+{
+    for (size_t offset = 0; offset < line.size(); offset += SIMD_BLOCK)
+    {
+        const char* block = line.data() + offset;
+        const size_t size = std::min(SIMD_BLOCK, line.size() - offset);
+        if (anyOfMask(block, TILE_CHARS, size) != blockBits(size))
+            throw std::invalid_argument("Unexpected value");
+        for (size_t i = 0; i < size; ++i)
+            data.push_back(TILE_FROM_CHAR[static_cast<unsigned char>(block[i])]);
+    }
+}
+
 char tileToChar(const ETile t)
 {
     switch (t)
@@ -181,7 +209,7 @@ int main()
         if (nCols == 0)
             nCols = line.size();
         ++nRows;
-        std::ranges::copy(line | std::views::transform(charToTile), std::back_inserter(data));
+        appendRow(line, data);
     }
 
     auto maze = std::mdspan(data.data(), nRows, nCols);
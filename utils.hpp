@@ -3,19 +3,44 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <cctype>
+#include <charconv>
 #include <concepts>
+#include <coroutine>
+#include <exception>
+#include <fstream>
 #include <numeric>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <ranges>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 using uint32 = unsigned int;
 using uint64 = unsigned long long int;
 using int32 = int;
 using int64 = long long int;
+using uint128 = unsigned __int128;
+using int128 = __int128;
 
 
 
@@ -96,6 +121,28 @@ std::string strip(std::string s)
 }
 
 
+std::string toString(uint128 value)
+{
+    std::string result;
+    do
+    {
+        result.push_back(static_cast<char>('0' + static_cast<int>(value % 10)));
+        value /= 10;
+    } while (value != 0);
+    std::ranges::reverse(result);
+    return result;
+}
+
+std::string toString(int128 value)
+{
+    if (value < 0)
+    {
+        return '-' + toString(-static_cast<uint128>(value));
+    }
+    return toString(static_cast<uint128>(value));
+}
+
+
 template<std::ranges::range Container>
 void print(const Container& container) {
     std::cout << '[';
@@ -122,6 +169,31 @@ std::optional<size_t> indexOf(const Container& container, const typename Contain
     }
 }
 
+/*
+ * Stable LSD radix sort on the bits [lowBit, highBit) of the values, one byte
+ * per pass. Bits outside the range are carried along but not compared.
+ */
+void radixSort(std::vector<uint64>& values, unsigned lowBit = 0, unsigned highBit = 64)
+{
+    std::vector<uint64> buffer(values.size());
+    for (unsigned shift = lowBit; shift < highBit; shift += 8)
+    {
+        const unsigned width = std::min(8u, highBit - shift);
+        const uint64 mask = (uint64 {1} << width) - 1;
+        std::array<size_t, 257> offsets {};
+        for (const uint64 value : values)
+        {
+            ++offsets[((value >> shift) & mask) + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        for (const uint64 value : values)
+        {
+            buffer[offsets[(value >> shift) & mask]++] = value;
+        }
+        values.swap(buffer);
+    }
+}
+
 template<typename T, typename F>
 concept Comparator = requires(F f, const T& a, const T& b) {
     { f(a, b) } -> std::convertible_to<bool>;
@@ -259,3 +331,484 @@ private:
     std::vector<CyclicProcess> cycles;
 };
 
+/*
+ * Lazy coroutine generator. Yields values one at a time so inputs can be parsed
+ * as a stream instead of being collected into containers first. Works as an
+ * input range so it can be used in range-for loops and with views.
+ */
+template<typename T>
+class Generator
+{
+public:
+    struct promise_type
+    {
+        std::optional<T> current;
+        std::exception_ptr exception;
+
+        Generator get_return_object()
+        {
+            return Generator {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        std::suspend_always yield_value(T value)
+        {
+            current = std::move(value);
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    class iterator
+    {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        explicit iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        const T& operator*() const { return *handle.promise().current; }
+
+        iterator& operator++()
+        {
+            resume(handle);
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const { return !handle || handle.done(); }
+
+    private:
+        std::coroutine_handle<promise_type> handle {};
+    };
+
+    explicit Generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+    Generator& operator=(Generator&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    ~Generator()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    iterator begin()
+    {
+        resume(handle);
+        return iterator {handle};
+    }
+
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    static void resume(std::coroutine_handle<promise_type> handle)
+    {
+        handle.resume();
+        if (handle.promise().exception)
+        {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+};
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Error opening file");
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return std::move(buffer).str();
+}
+
+/*
+ * Read-only view of a whole file. Uses mmap where available so large inputs
+ * are paged in on demand instead of being copied, and falls back to readFile
+ * otherwise. Like std::ifstream, a file that cannot be opened does not
+ * throw; it tests false and views as empty.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#if __has_include(<sys/mman.h>)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+        opened = true;
+        struct stat info {};
+        if (::fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            size = static_cast<size_t>(info.st_size);
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                data = static_cast<const char*>(mapped);
+                ::madvise(mapped, size, MADV_SEQUENTIAL);
+            }
+            else
+            {
+                size = 0;
+            }
+        }
+        ::close(fd);
+        if (data != nullptr || info.st_size == 0)
+        {
+            return;
+        }
+#endif
+        try
+        {
+            fallback = readFile(path);
+        }
+        catch (const std::runtime_error&)
+        {
+            opened = false;
+            return;
+        }
+        opened = true;
+        data = fallback.data();
+        size = fallback.size();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+#if __has_include(<sys/mman.h>)
+        if (data != nullptr && data != fallback.data())
+        {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+    }
+
+    explicit operator bool() const { return opened; }
+
+    std::string_view view() const { return {data, size}; }
+
+private:
+    bool opened {false};
+    const char* data {nullptr};
+    size_t size {0};
+    std::string fallback;
+};
+
+/*
+ * Yields each line of the buffer without the trailing '\n'. The buffer must
+ * outlive the generator.
+ */
+Generator<std::string_view> lines(std::string_view buffer)
+{
+    while (!buffer.empty())
+    {
+        const auto pos = buffer.find('\n');
+        if (pos == std::string_view::npos)
+        {
+            co_yield buffer;
+            co_return;
+        }
+        co_yield buffer.substr(0, pos);
+        buffer.remove_prefix(pos + 1);
+    }
+}
+
+/*
+ * Yields each line read from the stream. Only the current line is kept in
+ * memory: a yielded view is valid until the generator is advanced.
+ */
+Generator<std::string_view> lines(std::istream& stream)
+{
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        co_yield line;
+    }
+}
+
+/*
+ * Yields every integer found in the text, skipping any separator. A leading '-'
+ * is only taken as a sign for signed types.
+ */
+template<std::integral T = uint64>
+Generator<T> numbers(std::string_view text)
+{
+    const char* it = text.data();
+    const char* const last = text.data() + text.size();
+    while (it != last)
+    {
+        const bool isNumberStart =
+            std::isdigit(*it) ||
+            (std::is_signed_v<T> && *it == '-' && it + 1 != last && std::isdigit(it[1]));
+        if (!isNumberStart)
+        {
+            ++it;
+            continue;
+        }
+        T value {};
+        it = std::from_chars(it, last, value).ptr;
+        co_yield value;
+    }
+}
+
+/*
+ * Byte scanning primitives. Each *Mask function classifies a block of up to
+ * SIMD_BLOCK bytes and returns one bit per byte (bit i for data[i]). Full
+ * blocks use AVX2 or SSE2 when the target supports them, partial blocks at the
+ * end of a buffer go through the scalar fallback.
+ */
+constexpr size_t SIMD_BLOCK = 32;
+
+template<typename Pred>
+uint32 scalarMask(const char* data, size_t size, Pred pred)
+{
+    uint32 mask = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        mask |= static_cast<uint32>(pred(data[i])) << i;
+    }
+    return mask;
+}
+
+uint32 eqMask(const char* data, char c, size_t size = SIMD_BLOCK)
+{
+    if (size == SIMD_BLOCK)
+    {
+#if defined(__AVX2__)
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+#elif defined(__SSE2__)
+        const __m128i needle = _mm_set1_epi8(c);
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle))) |
+               static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle))) << 16;
+#endif
+    }
+    return scalarMask(data, size, [c](char x) { return x == c; });
+}
+
+/*
+ * Bytes in the inclusive range [first, last], e.g. ('0', '9') for digits.
+ */
+uint32 rangeMask(const char* data, char first, char last, size_t size = SIMD_BLOCK)
+{
+    if (size == SIMD_BLOCK)
+    {
+        // x is in range iff (x - first) as unsigned is not above (last - first)
+#if defined(__AVX2__)
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        const __m256i shifted = _mm256_sub_epi8(block, _mm256_set1_epi8(first));
+        const __m256i inRange = _mm256_cmpeq_epi8(
+            _mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(last - first))),
+            shifted);
+        return _mm256_movemask_epi8(inRange);
+#elif defined(__SSE2__)
+        const __m128i lower = _mm_set1_epi8(first);
+        const __m128i width = _mm_set1_epi8(static_cast<char>(last - first));
+        uint32 mask = 0;
+        for (size_t half = 0; half < 2; ++half)
+        {
+            const __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * half));
+            const __m128i shifted = _mm_sub_epi8(block, lower);
+            const __m128i inRange = _mm_cmpeq_epi8(_mm_min_epu8(shifted, width), shifted);
+            mask |= static_cast<uint32>(_mm_movemask_epi8(inRange)) << (16 * half);
+        }
+        return mask;
+#endif
+    }
+    return scalarMask(data,
+                      size,
+                      [first, last](char x)
+                      {
+                          return static_cast<unsigned char>(x - first) <=
+                                 static_cast<unsigned char>(last - first);
+                      });
+}
+
+uint32 digitMask(const char* data, size_t size = SIMD_BLOCK)
+{
+    return rangeMask(data, '0', '9', size);
+}
+
+/*
+ * Bytes equal to any of the characters in set.
+ */
+uint32 anyOfMask(const char* data, std::string_view set, size_t size = SIMD_BLOCK)
+{
+    uint32 mask = 0;
+    for (const char c : set)
+    {
+        mask |= eqMask(data, c, size);
+    }
+    return mask;
+}
+
+/*
+ * Mask with the lowest size bits set, i.e. every byte of a (partial) block.
+ */
+constexpr uint32 blockBits(size_t size)
+{
+    return size >= 32 ? ~uint32 {0} : (uint32 {1} << size) - 1;
+}
+
+/*
+ * Calls f(index) for every byte of text selected by blockMask(data, size).
+ */
+template<typename MaskFn, typename F>
+void forEachMatch(std::string_view text, MaskFn blockMask, F f)
+{
+    for (size_t offset = 0; offset < text.size(); offset += SIMD_BLOCK)
+    {
+        const size_t size = std::min(SIMD_BLOCK, text.size() - offset);
+        for (uint32 mask = blockMask(text.data() + offset, size); mask != 0; mask &= mask - 1)
+        {
+            f(offset + std::countr_zero(mask));
+        }
+    }
+}
+
+template<typename F>
+void forEachMatch(std::string_view text, char c, F f)
+{
+    forEachMatch(
+        text,
+        [c](const char* data, size_t size) { return eqMask(data, c, size); },
+        f);
+}
+
+size_t findFirstOf(std::string_view text, std::string_view set, size_t pos = 0)
+{
+    for (size_t offset = pos; offset < text.size(); offset += SIMD_BLOCK)
+    {
+        const size_t size = std::min(SIMD_BLOCK, text.size() - offset);
+        if (const uint32 mask = anyOfMask(text.data() + offset, set, size); mask != 0)
+        {
+            return offset + std::countr_zero(mask);
+        }
+    }
+    return std::string_view::npos;
+}
+
+size_t countByte(std::string_view text, char c)
+{
+    size_t count = 0;
+    for (size_t offset = 0; offset < text.size(); offset += SIMD_BLOCK)
+    {
+        const size_t size = std::min(SIMD_BLOCK, text.size() - offset);
+        count += std::popcount(eqMask(text.data() + offset, c, size));
+    }
+    return count;
+}
+
+/*
+ * Positions of every '\n' in text, so lines can be addressed without rescanning.
+ */
+std::vector<size_t> newlineIndex(std::string_view text)
+{
+    std::vector<size_t> result;
+    result.reserve(countByte(text, '\n'));
+    forEachMatch(text, '\n', [&result](size_t pos) { result.push_back(pos); });
+    return result;
+}
+
+size_t defaultThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*
+ * Calls f(i) for every i in [0, n), splitting the indices into one contiguous
+ * range per thread. f must be safe to call concurrently for different indices.
+ */
+template<typename F>
+void parallel_for(size_t n, F f, size_t nThreads = defaultThreadCount())
+{
+    nThreads = std::max<size_t>(1, std::min(nThreads, n));
+    if (nThreads == 1)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            f(i);
+        }
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads);
+    for (size_t t = 0; t < nThreads; ++t)
+    {
+        const size_t begin = n * t / nThreads;
+        const size_t end = n * (t + 1) / nThreads;
+        workers.emplace_back(
+            [begin, end, &f]
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    f(i);
+                }
+            });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/*
+ * Splits the buffer into at most nChunks pieces of similar size, moving every
+ * cut to just after a '\n' so that no line is shared between two chunks.
+ */
+std::vector<std::string_view> splitOnLines(std::string_view buffer, size_t nChunks)
+{
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    for (size_t i = 1; i <= nChunks && begin < buffer.size(); ++i)
+    {
+        size_t end = buffer.size();
+        if (i < nChunks)
+        {
+            end = std::max(begin, buffer.size() * i / nChunks);
+            end = buffer.find('\n', end);
+            end = end == std::string_view::npos ? buffer.size() : end + 1;
+        }
+        chunks.push_back(buffer.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}